@@ -20,15 +20,18 @@
 #include "semistatic.h"
 #include "dynamic.h"
 #include "cha.h"
+#include "query.h"
+#include "pipeline.h"
+#include <algorithm>
 #include <sstream>
 #include <fstream>
 #include <math.h>
 
 
-void CHA::init() {
-  KnightDistance::init();
-  SemiStatic::init();
-};
+// All the tables are generated at compile time, there is nothing left to
+// initialize (kept for compatibility)
+
+void CHA::init() {};
 
 bool CHA::is_unwinnable(Position& pos, Color intendedWinner) {
   static DYNAMIC::Search search = DYNAMIC::Search();
@@ -38,14 +41,115 @@ bool CHA::is_unwinnable(Position& pos, Color intendedWinner) {
   return DYNAMIC::UNWINNABLE == DYNAMIC::full_analysis(pos, search);
 };
 
-bool CHA::is_dead(Position& pos) {
-  static DYNAMIC::Search search = DYNAMIC::Search();
+// Both players are analyzed in one pass (see DYNAMIC::dead_analysis), the
+// searches are interleaved so each of them needs its own table
 
-  search.set_winner(WHITE);
-  DYNAMIC::SearchResult result = DYNAMIC::full_analysis(pos, search);
+bool CHA::is_dead(Position& pos) {
+  static DYNAMIC::Search white = DYNAMIC::Search();
+  static DYNAMIC::Search black = DYNAMIC::Search();
+  static TranspositionTable blackTT;
+  static bool initialized = false;
 
-  if (result != DYNAMIC::UNWINNABLE) return false;
+  if (!initialized) {
+    black.set_tt(&blackTT, size_t(Options["Hash"]));
+    initialized = true;
+  }
 
-  search.set_winner(BLACK);
-  return DYNAMIC::UNWINNABLE == DYNAMIC::full_analysis(pos, search);
+  return DYNAMIC::UNWINNABLE == DYNAMIC::dead_analysis(pos, white, black);
 };
+
+namespace {
+
+CHA::Verdict verdict(DYNAMIC::SearchResult result) {
+  return result == DYNAMIC::WINNABLE     ? CHA::WINNABLE
+         : result == DYNAMIC::UNWINNABLE ? CHA::UNWINNABLE
+                                         : CHA::UNDETERMINED;
+}
+
+// Whether [fen] is a valid FEN (see QUERY::is_valid_fen) and nothing else: at
+// most the two counters may follow its four fields. Anything more would be
+// read as part of the query (an intended winner, options overriding the batch
+// options, or a comment).
+
+bool is_plain_fen(const std::string& fen) {
+  std::istringstream iss(fen);
+  std::string token, error;
+  int fields = 0;
+
+  while (iss >> token)
+    if (++fields > 6 ||
+        (fields > 4 && token.find_first_not_of("0123456789") != std::string::npos))
+      return false;
+
+  return QUERY::is_valid_fen(fen, error);
+}
+
+// The analyzers of the batches with several threads, kept while the threads
+// and the budgets do not change (one batch at a time)
+
+std::mutex PoolMutex;
+std::unique_ptr<PIPELINE::Pool> BatchPool;
+CHA::BatchOptions PoolOptions;
+
+}  // namespace
+
+void CHA::analyze_batch(const PositionSpec* specs, Result* results, size_t n,
+                        const BatchOptions& options) {
+  QUERY::Settings settings;
+  settings.globalLimit = options.limit;
+  settings.timeLimit = options.timeLimit;
+  settings.profiling = options.profiling;
+
+  // One query per valid position, whether a position is dead is checked for
+  // both players in one pass (see DYNAMIC::dead_analysis)
+  std::vector<std::string> lines;
+  std::vector<size_t> queried;
+  for (size_t i = 0; i < n; ++i) {
+    results[i] = Result();
+    results[i].verdict = CHA::INVALID;
+
+    if (!is_plain_fen(specs[i].fen)) continue;
+
+    lines.push_back(specs[i].fen + (specs[i].intendedWinner == WHITE   ? " white"
+                                    : specs[i].intendedWinner == BLACK ? " black"
+                                                                       : " -dead"));
+    queried.push_back(i);
+  }
+
+  std::vector<QUERY::Answer> answers(lines.size());
+
+  if (options.threads <= 1) {
+    static thread_local std::unique_ptr<QUERY::Context> ctx;
+    if (!ctx) ctx.reset(new QUERY::Context());
+
+    // Only the limit changes, the tables are kept (see QUERY::Context::init)
+    ctx->init(settings);
+    for (size_t j = 0; j < lines.size(); ++j)
+      QUERY::analyze(*ctx, lines[j], settings, answers[j]);
+  }
+
+  else {
+    std::lock_guard<std::mutex> lock(PoolMutex);
+
+    if (!BatchPool || PoolOptions.threads != options.threads ||
+        PoolOptions.limit != options.limit ||
+        PoolOptions.timeLimit != options.timeLimit ||
+        PoolOptions.profiling != options.profiling) {
+      BatchPool.reset();
+      BatchPool.reset(new PIPELINE::Pool(settings, options.threads));
+      PoolOptions = options;
+    }
+
+    BatchPool->analyze(lines.data(), answers.data(), lines.size());
+  }
+
+  for (size_t j = 0; j < lines.size(); ++j) {
+    Result& result = results[queried[j]];
+    result.verdict =
+        answers[j].valid ? verdict(answers[j].result) : CHA::INVALID;
+    result.nodes = answers[j].nodes;
+    result.duration = answers[j].duration;
+    std::copy(answers[j].phases, answers[j].phases + DYNAMIC::PHASE_NB,
+              result.phases);
+  }
+}
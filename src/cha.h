@@ -19,6 +19,8 @@
 #define CHA_H_INCLUDED
 
 #include "stockfish.h"
+#include "dynamic.h"
+#include <string>
 
 namespace CHA {
 
@@ -31,6 +33,43 @@ bool is_unwinnable(Position&, Color);
 // [is_dead(pos)] is [true] if [pos] is a dead position
 bool is_dead(Position&);
 
+// Batch analysis, e.g. to adjudicate many finished games at once. Every
+// position is given by its FEN and the player whose winning chances are
+// analyzed, or COLOR_NB to check whether the position is dead (in which case
+// the verdict is UNWINNABLE if no player can win, WINNABLE if some can).
+// Positions with a malformed FEN are not analyzed, their verdict is INVALID
+// (this includes FENs followed by anything but the two counters).
+
+enum Verdict { WINNABLE, UNWINNABLE, UNDETERMINED, INVALID };
+
+struct PositionSpec {
+  std::string fen;
+  Color intendedWinner;
+};
+
+// The statistics of every phase of the analysis are given in [phases] (their
+// time and saturations are only measured with BatchOptions::profiling).
+
+struct Result {
+  Verdict verdict;
+  uint64_t nodes;
+  uint64_t duration;  // In nanoseconds
+  DYNAMIC::PhaseStats phases[DYNAMIC::PHASE_NB];
+};
+
+struct BatchOptions {
+  int threads = 1;           // With 1, positions are analyzed in this thread
+  uint64_t limit = 5000000;  // Nodes per analysis
+  uint64_t timeLimit = 0;    // Per analysis in microseconds, 0 means no limit
+  bool profiling = false;    // Measure the time and saturations of the phases
+};
+
+// [analyze_batch(specs, results, n)] analyzes the [n] positions [specs] into
+// [results]. The analysis contexts (and the threads) are kept from one batch
+// to the next.
+void analyze_batch(const PositionSpec* specs, Result* results, size_t n,
+                   const BatchOptions& options = BatchOptions());
+
 }  // namespace CHA
 
 #endif  // #ifndef CHA_H_INCLUDED
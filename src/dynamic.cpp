@@ -136,10 +136,29 @@ bool find_mate(Position& pos, DYNAMIC::Search& search, Depth depth,
 
   // If the position is found with more depth, we can ignore this branch
   if (MODE == DYNAMIC::FULL) {
-    tte = TT.probe(pos.key(), found);
-    if (found && (tte->depth() >= movesLeft)) return false;
+    tte = search.tt().probe(pos.key(), found);
+    if (found && (tte->depth() >= movesLeft)) {
+      search.count_tt_hit();
+      return false;
+    }
   }
 
+  // A position repeated on the current path (StateInfo::repetition is the
+  // distance in plies to its previous occurrence, which is on the path of this
+  // find_mate if it is not before its root) cannot lead to a mate that was not
+  // reachable from there, if it was searched with at least as many moves left
+  // and the same flags (which decide the depth of every move). Earlier plies
+  // (trivial progress or previous searches) were not annotated by this search.
+  // This does not change the verdicts: a mating sequence never needs to go
+  // through a cycle.
+  int ply = search.actual_depth();
+  int repetition = std::abs(pos.state()->repetition);
+  if (repetition && ply - repetition >= search.root_depth() &&
+      search.covers(ply - repetition, depth, pastProgress, wasSemiBlocked))
+    return false;
+
+  search.annotate_depth(depth, pastProgress, wasSemiBlocked);
+
   // Insufficient material to win
   if (impossible_to_win(pos, winner)) return false;
 
@@ -150,6 +169,16 @@ bool find_mate(Position& pos, DYNAMIC::Search& search, Depth depth,
     return true;
   }
 
+  // Semistatic pruning (before the depth limit, so that pruned leaves do not
+  // interrupt the search). It is only worth trying after a capture, in
+  // positions with blocked pawns: pawn pushes alone rarely make the position
+  // unwinnable, and they would cost a saturation at most of the nodes.
+  if (MODE == DYNAMIC::FULL && ply > 0 && search.is_pruning() &&
+      pos.state()->capturedPiece &&
+      UTIL::nb_blocked_pawns(pos) >= 1 && !UTIL::has_lonely_pawns(pos) &&
+      SemiStatic::is_unwinnable_cached(pos, winner, search.cancel_flag()))
+    return false;
+
   // Search limits
   if (depth >= search.max_depth() || search.is_local_limit_reached()) {
     search.interrupt();
@@ -251,6 +280,10 @@ bool find_mate(Position& pos, DYNAMIC::Search& search, Depth depth,
       }
     }
 
+    if (search.tracer())
+      search.tracer()->visit(search.actual_depth(), m, variation, depth,
+                             newDepth, search.get_nb_nodes());
+
     // Continue the search from the new position
     search.annotate_move(m);
     search.step();
@@ -265,6 +298,12 @@ bool find_mate(Position& pos, DYNAMIC::Search& search, Depth depth,
 
     if (checkMate) return true;
 
+    // The remaining moves are not explored, so this is not a proof either
+    if (search.must_stop()) {
+      search.interrupt();
+      return false;
+    }
+
   }  // end of iteration over legal moves
 
   return false;
@@ -279,8 +318,8 @@ bool dynamically_unwinnable(Position& pos, Depth depth, Color winner,
   if (MoveList<LEGAL>(pos).size() == 0 && pos.checkers())
     return pos.side_to_move() == winner;
 
-  // Maximum depth reached
-  if (depth <= 0) return false;
+  // Maximum depth reached (or we must stop, this is not a proof either)
+  if (depth <= 0 || search.must_stop()) return false;
 
   // Iterate over all legal moves
   for (const ExtMove& m : MoveList<LEGAL>(pos)) {
@@ -335,20 +374,22 @@ DYNAMIC::SearchResult full_analysis_aux(Position& pos, StateInfo& st,
   search.set(2, 0, 5000);
   mate = find_mate<DYNAMIC::QUICK, DYNAMIC::ANY>(pos, search, 0, false, false);
 
-  if (!search.is_interrupted() && !mate) search.set_unwinnable();
+  if (!search.is_interrupted() && !search.must_stop() && !mate)
+    search.set_unwinnable();
 
   Depth initDepth = 0;
 
   if (search.get_result() == DYNAMIC::UNDETERMINED) {
     initDepth = trivial_progress(pos, st, search, 100);
     search.set_flag(DYNAMIC::STATIC);
-    if (SemiStatic::is_unwinnable(pos, search.intended_winner()))
+    if (SemiStatic::is_unwinnable(pos, search.intended_winner(),
+                                 search.cancel_flag()))
       search.set_unwinnable();
   }
 
   if (search.get_result() == DYNAMIC::UNDETERMINED) {
     search.set_flag(DYNAMIC::POST_STATIC);
-    TT.clear();
+    search.clear_tt();
 
     // Apply iterative deepening (find_mate may look deeper than maxDepth on
     // rewarded variations)
@@ -359,7 +400,8 @@ DYNAMIC::SearchResult full_analysis_aux(Position& pos, StateInfo& st,
       mate =
           find_mate<DYNAMIC::FULL, DYNAMIC::ANY>(pos, search, 0, false, false);
 
-      if (!search.is_interrupted() && !mate) search.set_unwinnable();
+      if (!search.is_interrupted() && !search.must_stop() && !mate)
+        search.set_unwinnable();
 
       if (search.get_result() != DYNAMIC::UNDETERMINED ||
           search.is_limit_reached())
@@ -387,6 +429,7 @@ DYNAMIC::SearchResult DYNAMIC::quick_analysis(Position& pos,
   bool almostOnlyPawnsAndBishops = popcount(KRQ) <= 1;
   int movedKings = 0;
 
+  search.begin_phase(DYNAMIC::EXHAUSTIVE);
   unwinnable = dynamically_unwinnable(pos, 7, search.intended_winner(), search,
                                       movedKings);
   // if the position only contains pawns and/or bishops, at least one of the
@@ -394,21 +437,29 @@ DYNAMIC::SearchResult DYNAMIC::quick_analysis(Position& pos,
   // moves is restricted, repeat a deeper search
   // TODO: remove if this turns out to be too ad hoc for capturing bKHPqNEw
   if (!unwinnable && onlyPawnsAndBishops && movedKings != 3 &&
-      MoveList<LEGAL>(pos).size() <= 8)
+      MoveList<LEGAL>(pos).size() <= 8 && !search.must_stop())
     unwinnable = dynamically_unwinnable(pos, 15, search.intended_winner(),
                                         search, movedKings);
+  search.end_phase();
 
-  bool blockedCandidate =
-      UTIL::nb_blocked_pawns(pos) >= 1 && !UTIL::has_lonely_pawns(pos);
+  bool blockedCandidate = UTIL::nb_blocked_pawns(pos) >= 1 &&
+                          !UTIL::has_lonely_pawns(pos) &&
+                          !search.must_stop();
 
-  if (blockedCandidate && !unwinnable && onlyPawnsAndBishops)
-    if (SemiStatic::is_unwinnable(pos, search.intended_winner()))
-      unwinnable = true;
+  if (blockedCandidate && !unwinnable && onlyPawnsAndBishops) {
+    search.begin_phase(DYNAMIC::SEMISTATIC);
+    unwinnable = SemiStatic::is_unwinnable(pos, search.intended_winner(),
+                                           search.cancel_flag());
+    search.end_phase();
+  }
 
   if (!stable && blockedCandidate && !unwinnable &&
-      (almostOnlyPawnsAndBishops && (pos.checkers() || pos.pieces(KNIGHT))))
-    if (SemiStatic::is_unwinnable_after_one_move(pos, search.intended_winner()))
-      unwinnable = true;
+      (almostOnlyPawnsAndBishops && (pos.checkers() || pos.pieces(KNIGHT)))) {
+    search.begin_phase(DYNAMIC::BRANCHES);
+    unwinnable = SemiStatic::is_unwinnable_after_one_move(
+        pos, search.intended_winner(), search.cancel_flag());
+    search.end_phase();
+  }
 
   if (unwinnable) search.set_unwinnable();
 
@@ -420,10 +471,14 @@ DYNAMIC::SearchResult DYNAMIC::find_shortest(Position& pos,
   bool mate;
   search.init();
 
-  if (SemiStatic::is_unwinnable(pos, search.intended_winner()))
+  search.begin_phase(DYNAMIC::SEMISTATIC);
+  if (SemiStatic::is_unwinnable(pos, search.intended_winner(),
+                                search.cancel_flag()))
     search.set_unwinnable();
+  search.end_phase();
 
-  TT.clear();
+  search.begin_phase(DYNAMIC::DEEPENING);
+  search.clear_tt();
 
   int initial_depth = pos.side_to_move() == search.intended_winner() ? 1 : 0;
 
@@ -432,44 +487,163 @@ DYNAMIC::SearchResult DYNAMIC::find_shortest(Position& pos,
     mate = find_mate<DYNAMIC::FULL, DYNAMIC::SHORTEST>(pos, search, 0, false,
                                                        false);
 
-    if (!search.is_interrupted() && !mate) search.set_unwinnable();
+    if (!search.is_interrupted() && !search.must_stop() && !mate)
+      search.set_unwinnable();
 
     if (search.get_result() != DYNAMIC::UNDETERMINED ||
         search.is_limit_reached())
       break;
   }
+  search.end_phase();
 
   return search.get_result();
 }
 
+// A quick find_mate from the root, as in the probe of full_analysis (without
+// the transposition table, so that repeated calls are comparable)
+
+bool DYNAMIC::find_mate_at_depth(Position& pos, DYNAMIC::Search& search,
+                                 Depth depth) {
+  search.init();
+  search.set(depth, 0, search.get_limit());
+  return find_mate<DYNAMIC::QUICK, DYNAMIC::ANY>(pos, search, 0, false, false);
+}
+
+// The exhaustive search of quick_analysis, true if unwinnable up to [depth]
+
+bool DYNAMIC::exhaustive_search(Position& pos, DYNAMIC::Search& search,
+                                Depth depth) {
+  int movedKings = 0;
+  search.init();
+  search.set(depth, 0, search.get_limit());
+  return dynamically_unwinnable(pos, depth, search.intended_winner(), search,
+                                movedKings);
+}
+
 // DYNAMIC::print_result() prints one line of information about the search.
 
-void DYNAMIC::Search::print_result() const {
+void DYNAMIC::Search::print_result(std::ostream& os) const {
   if (result == WINNABLE) {
-    std::cout << "winnable";
-    for (int i = 0; i < std::min(mateLen, MAX_VARIATION_LENGTH); i++)
-      std::cout << " " << UCI::move(checkmateSequence[i], false);
-    std::cout << "#";
+    os << "winnable";
+    for (int i = 0; i < std::min(mateLen, int(path.size())); i++)
+      os << " " << UCI::move(path[i].move, false);
+    os << "#";
   }
 
   else if (result == UNWINNABLE)
-    std::cout << "unwinnable";
+    os << "unwinnable";
+
+  else if (get_result() == CANCELLED)
+    os << "cancelled";
 
   else
-    std::cout << "undetermined";
+    os << "undetermined";
+
+  os << " nodes " << (totalCounter + counter);
+}
+
+const char* DYNAMIC::phase_name(Phase phase) {
+  static const char* names[PHASE_NB] = {"probe", "semistatic", "branches",
+                                        "deepening", "exhaustive"};
+  return names[phase];
+}
 
-  std::cout << " nodes " << (totalCounter + counter);
+void DYNAMIC::Search::begin_phase(Phase p) {
+  phase = p;
+  snapshot.nodes = get_nb_nodes();
+  snapshot.ttHits = ttHits;
+
+  if (profiling) {
+    snapshot.saturations = SemiStatic::counters().saturations;
+    snapshot.rounds = SemiStatic::counters().rounds;
+    if (perf) perf->read(snapshot.counters);
+    phaseStart = std::chrono::steady_clock::now();
+  }
+}
+
+void DYNAMIC::Search::end_phase() {
+  PhaseStats& stats = phaseStats[phase];
+  stats.calls++;
+  stats.nodes += get_nb_nodes() - snapshot.nodes;
+  stats.ttHits += ttHits - snapshot.ttHits;
+
+  if (profiling) {
+    stats.saturations += SemiStatic::counters().saturations - snapshot.saturations;
+    stats.rounds += SemiStatic::counters().rounds - snapshot.rounds;
+    stats.time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - phaseStart)
+                      .count();
+
+    if (perf) {
+      uint64_t counters[PERF::EVENT_NB];
+      perf->read(counters);
+      for (int e = 0; e < PERF::EVENT_NB; ++e)
+        stats.counters[e] += counters[e] - snapshot.counters[e];
+    }
+  }
+}
+
+// The counters are opened on the thread calling this function, which must be
+// the one running the searches
+
+void DYNAMIC::Search::set_perf_counters(bool enabled) {
+  perf = enabled ? PERF::thread_group() : nullptr;
+}
+
+// DYNAMIC::print_phases() prints the statistics of the phases that were run,
+// as: phase <name> calls <n> time <us> nodes <n> saturations <n> rounds <n>
+// tthits <n>, followed by the hardware counters if they are enabled
+
+void DYNAMIC::Search::print_phases(std::ostream& os) const {
+  DYNAMIC::print_phases(os, phaseStats, perf);
+}
+
+void DYNAMIC::print_phases(std::ostream& os, const PhaseStats stats[PHASE_NB],
+                           bool counters) {
+  for (int p = 0; p < PHASE_NB; ++p) {
+    if (!stats[p].calls) continue;
+
+    os << " phase " << phase_name(Phase(p)) << " calls " << stats[p].calls
+       << " time " << stats[p].time / 1000 << " nodes " << stats[p].nodes
+       << " saturations " << stats[p].saturations << " rounds "
+       << stats[p].rounds << " tthits " << stats[p].ttHits;
+
+    if (counters)
+      for (int e = 0; e < PERF::EVENT_NB; ++e)
+        os << " " << PERF::event_name(PERF::Event(e)) << " "
+           << stats[p].counters[e];
+  }
 }
 
 namespace {
 
-    // Check if the position is semistatically unwinnable with recursive trivial progress.
-    bool is_unwinnable_with_trivial_progress(Position& pos, Color intendedWinner) {
+    // The children of the root of full_analysis that need a saturation are
+    // saturated together (one Batch per thread).
+    thread_local SemiStatic::Batch BATCH;
+
+    // Check if the position is semistatically unwinnable with recursive trivial progress,
+    // for both players at once ([unwinnable] is indexed by intended winner).
+    // The position is not saturated here: if needed, it is added to [batch]
+    // and it is not unwinnable for any player yet, with its index in the batch
+    // in [pending] (which is -1 otherwise).
+    void unwinnable_with_trivial_progress(Position& pos, const std::atomic<bool>* cancel,
+                                          SemiStatic::Batch& batch,
+                                          bool unwinnable[COLOR_NB], int& pending) {
+        pending = -1;
+        unwinnable[WHITE] = unwinnable[BLACK] = false;
+
+        // A cancelled analysis proves nothing
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            return;
+
         MoveList<LEGAL> moveList(pos);
 
         // Checkmate or Stalemate
-        if (moveList.size() == 0)
-            return !pos.checkers() || pos.side_to_move() == intendedWinner;
+        if (moveList.size() == 0) {
+            for (Color c : {WHITE, BLACK})
+                unwinnable[c] = !pos.checkers() || pos.side_to_move() == c;
+            return;
+        }
 
         // Recursive trivial progress
         if (moveList.size() == 1)
@@ -477,14 +651,32 @@ namespace {
             StateInfo stateInfo;
             pos.do_move(*moveList.begin(), stateInfo);
 
-            // Returns true if the position is repeated.
-            bool res = stateInfo.repetition || is_unwinnable_with_trivial_progress(pos, intendedWinner);
+            // Unwinnable if the position is repeated.
+            if (stateInfo.repetition)
+                unwinnable[WHITE] = unwinnable[BLACK] = true;
+            else
+                unwinnable_with_trivial_progress(pos, cancel, batch, unwinnable, pending);
 
             pos.undo_move(*moveList.begin());
-            return res;
+            return;
+        }
+
+        // With legal moves, settling does not depend on the intended winner
+        bool settled;
+        if (SemiStatic::settle(pos, WHITE, settled)) {
+            unwinnable[WHITE] = unwinnable[BLACK] = settled;
+            return;
         }
 
-        return SemiStatic::is_unwinnable(pos, intendedWinner);
+        pending = int(batch.add(pos));
+    }
+
+    bool is_unwinnable_with_trivial_progress(Position& pos, Color intendedWinner,
+                                             const std::atomic<bool>* cancel,
+                                             SemiStatic::Batch& batch, int& pending) {
+        bool unwinnable[COLOR_NB];
+        unwinnable_with_trivial_progress(pos, cancel, batch, unwinnable, pending);
+        return unwinnable[intendedWinner];
     }
 
     bool side_to_move_can_capture_king(const Position& pos) {
@@ -506,7 +698,7 @@ namespace {
             bool mate =
                 find_mate<DYNAMIC::FULL, DYNAMIC::ANY>(pos, search, 0, false, false);
 
-            if (!search.is_interrupted() && !mate)
+            if (!search.is_interrupted() && !search.must_stop() && !mate)
                 search.set_unwinnable();
 
             if (search.get_result() != DYNAMIC::UNDETERMINED ||
@@ -516,6 +708,54 @@ namespace {
 
         return search.get_result();
     }
+
+    // The deepening phase of full_analysis, one undefined branch at a time
+    // (so that the deepenings of several searches can be interleaved). If all
+    // the moves are undefined, the deepening is applied on the root instead.
+    class Deepening {
+    public:
+        Deepening(DYNAMIC::Search& s, const ExtMove* moves, size_t n, bool onRoot)
+            : search(s), branches(moves), nbBranches(onRoot ? 1 : n), root(onRoot) {}
+
+        bool done() const {
+            return next == nbBranches || (next > 0 && search.is_limit_reached()) ||
+                   search.get_result() == DYNAMIC::WINNABLE;
+        }
+
+        void advance(Position& pos) {
+            if (root) {
+                iterative_deepening(pos, search);
+                next++;
+                return;
+            }
+
+            Move m = branches[next++];
+            StateInfo st;
+            pos.do_move(m, st);
+            search.annotate_move(m);
+            search.step();
+            search.increase_cnt();
+
+            if (iterative_deepening(pos, search) == DYNAMIC::UNWINNABLE) {
+                search.set_undetermined();
+                unwinnableCount++;
+            }
+
+            pos.undo_move(m);
+            search.undo_step();
+
+            if (unwinnableCount == nbBranches)
+                search.set_unwinnable();
+        }
+
+    private:
+        DYNAMIC::Search& search;
+        const ExtMove* branches;
+        size_t nbBranches;
+        bool root;
+        size_t next = 0;
+        size_t unwinnableCount = 0;
+    };
 }
 
 DYNAMIC::SearchResult DYNAMIC::full_analysis(Position& pos, DYNAMIC::Search& search) {
@@ -530,15 +770,16 @@ DYNAMIC::SearchResult DYNAMIC::full_analysis(Position& pos, DYNAMIC::Search& sea
     // Required to detect repetitions 
     assert(pos.state()->pliesFromNull == 0);
 
-    std::deque<StateInfo> states;
-
-    // Trivial progress
-    while (true) {
+    // Trivial progress (the states are owned by the search, so that they are
+    // not allocated on every call and [pos] remains valid after it)
+    for (size_t ply = 0; ; ply++) {
         MoveList<LEGAL> moveList(pos);
 
+        if (search.must_stop())
+            return search.get_result();
+
         if (moveList.size() == 1) {
-            states.push_back(StateInfo());
-            pos.do_move(*moveList.begin(), states.back());
+            pos.do_move(*moveList.begin(), search.root_state(ply));
             search.annotate_move(*moveList.begin());
             search.step();
 
@@ -570,75 +811,278 @@ DYNAMIC::SearchResult DYNAMIC::full_analysis(Position& pos, DYNAMIC::Search& sea
     }
 
     // Apply a quick search of depth 2 (may be deeper on rewarded variations)
+    search.begin_phase(DYNAMIC::PROBE);
     search.set(2, 0, 5000);
     bool mate = find_mate<DYNAMIC::QUICK, DYNAMIC::ANY>(pos, search, 0, false, false);
+    search.end_phase();
 
-    if (!search.is_interrupted() && !mate)
+    if (!search.is_interrupted() && !search.must_stop() && !mate)
         search.set_unwinnable();
 
-    if (search.get_result() != DYNAMIC::UNDETERMINED)
+    if (search.get_result() != DYNAMIC::UNDETERMINED || search.must_stop())
         return search.get_result();
 
     search.set_flag(DYNAMIC::STATIC);
 
     // Check if the position is semistatically unwinnable
-    if (SemiStatic::is_unwinnable(pos, search.intended_winner())) {
+    search.begin_phase(DYNAMIC::SEMISTATIC);
+    bool unwinnable = SemiStatic::is_unwinnable(pos, search.intended_winner(),
+                                                search.cancel_flag());
+    search.end_phase();
+
+    if (unwinnable) {
         search.set_unwinnable();
         return search.get_result();
     }
 
     // Check if the position is unwinnable in positions at depth 1 ply
-    std::vector<ExtMove> undefinedBranches;
+    ExtMove undefinedBranches[MAX_MOVES];
+    int pending[MAX_MOVES];
+    size_t nbUndefinedBranches = 0;
+    search.begin_phase(DYNAMIC::BRANCHES);
+    BATCH.clear();
 
     for (auto& m : moveList) {
         StateInfo st;
         pos.do_move(m, st);
 
-        if (!is_unwinnable_with_trivial_progress(pos, search.intended_winner()))
-            undefinedBranches.push_back(m);
+        if (!is_unwinnable_with_trivial_progress(pos, search.intended_winner(),
+                                                 search.cancel_flag(), BATCH,
+                                                 pending[nbUndefinedBranches]))
+            undefinedBranches[nbUndefinedBranches++] = m;
 
         pos.undo_move(m);
     }
 
-    if (undefinedBranches.empty()) {
+    // Saturate the pending branches together and keep the undefined ones (if
+    // cancelled, they all are)
+    if (BATCH.size() && BATCH.saturate(search.cancel_flag())) {
+        size_t kept = 0;
+        for (size_t i = 0; i < nbUndefinedBranches; i++)
+            if (pending[i] < 0 ||
+                !BATCH.is_unwinnable(pending[i], search.intended_winner()))
+                undefinedBranches[kept++] = undefinedBranches[i];
+
+        nbUndefinedBranches = kept;
+    }
+    search.end_phase();
+
+    if (nbUndefinedBranches == 0) {
         search.set_unwinnable();
         return search.get_result();
     }
 
+    if (search.must_stop())
+        return search.get_result();
+
     search.set_flag(DYNAMIC::POST_STATIC);
+    search.begin_phase(DYNAMIC::DEEPENING);
 
-    if (undefinedBranches.size() != moveList.size()) {
-        TT.clear();
-        int unwinnableCount = 0;
-        for (const auto& m : undefinedBranches) {
-            StateInfo st;
-            pos.do_move(m, st);
-            search.annotate_move(m);
-            search.step();
-            search.increase_cnt();
+    Deepening deepening(search, undefinedBranches, nbUndefinedBranches,
+                        nbUndefinedBranches == moveList.size());
+    search.clear_tt();
 
-            if (iterative_deepening(pos, search) == DYNAMIC::UNWINNABLE) {
-                search.set_undetermined();
-                unwinnableCount++;
-            }
+    while (!deepening.done())
+        deepening.advance(pos);
 
-            pos.undo_move(m);
-            search.undo_step();
+    search.end_phase();
 
-            if (search.is_limit_reached())
-                break;
+    return search.get_result();
+}
 
-            if (search.get_result() == DYNAMIC::WINNABLE)
-                return search.get_result();
+// DYNAMIC::dead_analysis() shares the work of the two full analyses: the
+// trivial progress, the move generation, the saturations (the semistatic
+// analysis does not depend on the intended winner) and the branches at depth
+// 1. The phases that are shared are accounted to the first search. The
+// deepenings of both players are interleaved, one branch at a time, until a
+// player is found to be able to win.
+
+DYNAMIC::SearchResult DYNAMIC::dead_analysis(Position& pos, DYNAMIC::Search& white,
+                                             DYNAMIC::Search& black) {
+    DYNAMIC::Search* searches[COLOR_NB] = {&white, &black};
+    const std::atomic<bool>* cancel = white.cancel_flag();
+
+    for (Color c : {WHITE, BLACK}) {
+        searches[c]->set_winner(c);
+        searches[c]->init();
+        searches[c]->set(0, 0, 0);
+    }
+
+    auto verdict = [&]() {
+        DYNAMIC::SearchResult w = white.get_result();
+        DYNAMIC::SearchResult b = black.get_result();
+
+        if (w == DYNAMIC::WINNABLE || b == DYNAMIC::WINNABLE)
+            return DYNAMIC::WINNABLE;
+
+        return w == DYNAMIC::UNWINNABLE && b == DYNAMIC::UNWINNABLE
+                   ? DYNAMIC::UNWINNABLE
+                   : DYNAMIC::UNDETERMINED;
+    };
+
+    auto undetermined = [&](Color c) {
+        return searches[c]->get_result() == DYNAMIC::UNDETERMINED;
+    };
+
+    if (side_to_move_can_capture_king(pos)) {
+        white.set_unwinnable();
+        black.set_unwinnable();
+        return verdict();
+    }
+
+    // Required to detect repetitions
+    assert(pos.state()->pliesFromNull == 0);
+
+    // Trivial progress (with the states of the first search)
+    for (size_t ply = 0; ; ply++) {
+        MoveList<LEGAL> moveList(pos);
+
+        if (white.must_stop() || black.must_stop())
+            return verdict();
+
+        if (moveList.size() != 1)
+            break;
+
+        Move m = *moveList.begin();
+        pos.do_move(m, white.root_state(ply));
+
+        for (DYNAMIC::Search* search : searches) {
+            search->annotate_move(m);
+            search->step();
+        }
+
+        // If a position is forced to repeat, then it is unwinnable.
+        if (pos.state()->repetition) {
+            white.set_unwinnable();
+            black.set_unwinnable();
+            return verdict();
         }
+    }
 
-        if (unwinnableCount == undefinedBranches.size())
+    MoveList<LEGAL> moveList(pos);
+
+    // Checkmate or Stalemate
+    if (moveList.size() == 0) {
+        for (Color c : {WHITE, BLACK})
+            if (pos.checkers() && pos.side_to_move() == ~c)
+                searches[c]->set_winnable();
+            else
+                searches[c]->set_unwinnable();
+        return verdict();
+    }
+
+    // Insufficient material to win, or a quick search of depth 2
+    for (Color c : {WHITE, BLACK}) {
+        DYNAMIC::Search& search = *searches[c];
+
+        if (impossible_to_win(pos, c)) {
             search.set_unwinnable();
+            continue;
+        }
+
+        search.begin_phase(DYNAMIC::PROBE);
+        search.set(2, 0, 5000);
+        bool mate = find_mate<DYNAMIC::QUICK, DYNAMIC::ANY>(pos, search, 0, false, false);
+        search.end_phase();
+
+        if (!search.is_interrupted() && !search.must_stop() && !mate)
+            search.set_unwinnable();
+
+        if (search.get_result() == DYNAMIC::WINNABLE || search.must_stop())
+            return verdict();
+    }
+
+    if (!undetermined(WHITE) && !undetermined(BLACK))
+        return verdict();
+
+    // Check if the position is semistatically unwinnable (one saturation)
+    bool unwinnable[COLOR_NB];
+
+    for (DYNAMIC::Search* search : searches)
+        search->set_flag(DYNAMIC::STATIC);
+
+    white.begin_phase(DYNAMIC::SEMISTATIC);
+    SemiStatic::is_unwinnable_both(pos, unwinnable, cancel);
+    white.end_phase();
+
+    for (Color c : {WHITE, BLACK})
+        if (unwinnable[c] && undetermined(c))
+            searches[c]->set_unwinnable();
+
+    if (!undetermined(WHITE) && !undetermined(BLACK))
+        return verdict();
+
+    // Check if the position is unwinnable in positions at depth 1 ply (the
+    // children are saturated once, for both players)
+    ExtMove undefinedBranches[COLOR_NB][MAX_MOVES];
+    int pending[COLOR_NB][MAX_MOVES];
+    size_t nbUndefinedBranches[COLOR_NB] = {0, 0};
+    white.begin_phase(DYNAMIC::BRANCHES);
+    BATCH.clear();
+
+    for (auto& m : moveList) {
+        StateInfo st;
+        int slot;
+        pos.do_move(m, st);
+
+        unwinnable_with_trivial_progress(pos, cancel, BATCH, unwinnable, slot);
+
+        for (Color c : {WHITE, BLACK})
+            if (undetermined(c) && !unwinnable[c]) {
+                pending[c][nbUndefinedBranches[c]] = slot;
+                undefinedBranches[c][nbUndefinedBranches[c]++] = m;
+            }
+
+        pos.undo_move(m);
     }
-    else {
-        TT.clear();
-        iterative_deepening(pos, search);
+
+    if (BATCH.size() && BATCH.saturate(cancel))
+        for (Color c : {WHITE, BLACK}) {
+            size_t kept = 0;
+            for (size_t i = 0; i < nbUndefinedBranches[c]; i++)
+                if (pending[c][i] < 0 || !BATCH.is_unwinnable(pending[c][i], c))
+                    undefinedBranches[c][kept++] = undefinedBranches[c][i];
+
+            nbUndefinedBranches[c] = kept;
+        }
+    white.end_phase();
+
+    for (Color c : {WHITE, BLACK})
+        if (undetermined(c) && nbUndefinedBranches[c] == 0)
+            searches[c]->set_unwinnable();
+
+    if (white.must_stop() || black.must_stop())
+        return verdict();
+
+    // Interleave the deepenings of the players that are still undetermined
+    bool active[COLOR_NB];
+    Deepening deepenings[COLOR_NB] = {
+        Deepening(white, undefinedBranches[WHITE], nbUndefinedBranches[WHITE],
+                  nbUndefinedBranches[WHITE] == moveList.size()),
+        Deepening(black, undefinedBranches[BLACK], nbUndefinedBranches[BLACK],
+                  nbUndefinedBranches[BLACK] == moveList.size())};
+
+    for (Color c : {WHITE, BLACK}) {
+        active[c] = undetermined(c);
+        if (active[c]) {
+            searches[c]->set_flag(DYNAMIC::POST_STATIC);
+            searches[c]->clear_tt();
+        }
     }
 
-    return search.get_result();
+    while ((active[WHITE] && !deepenings[WHITE].done()) ||
+           (active[BLACK] && !deepenings[BLACK].done()))
+        for (Color c : {WHITE, BLACK}) {
+            if (!active[c] || deepenings[c].done())
+                continue;
+
+            searches[c]->begin_phase(DYNAMIC::DEEPENING);
+            deepenings[c].advance(pos);
+            searches[c]->end_phase();
+
+            if (searches[c]->get_result() == DYNAMIC::WINNABLE)
+                return verdict();
+        }
+
+    return verdict();
 }
@@ -18,15 +18,47 @@
 #ifndef DYNAMIC_H_INCLUDED
 #define DYNAMIC_H_INCLUDED
 
+#include <memory>
+#include <vector>
+
+#include "perf.h"
+#include "trace.h"
+
 namespace DYNAMIC {
 
-enum SearchResult { WINNABLE, UNWINNABLE, UNDETERMINED };
+enum SearchResult { WINNABLE, UNWINNABLE, UNDETERMINED, CANCELLED };
 
 enum SearchMode { FULL, QUICK };
 enum SearchTarget { ANY, SHORTEST };
 
 enum SearchFlag { PRE_STATIC, STATIC, POST_STATIC };
 
+// The phases of the analyses, for instrumentation purposes:
+//  * PROBE      : the quick find_mate of depth 2 (full analysis)
+//  * SEMISTATIC : the semistatic analysis of the position
+//  * BRANCHES   : the semistatic analysis of the positions at depth 1
+//  * DEEPENING  : the iterative deepening find_mate (full and shortest)
+//  * EXHAUSTIVE : the exhaustive search of limited depth (quick analysis)
+
+enum Phase { PROBE, SEMISTATIC, BRANCHES, DEEPENING, EXHAUSTIVE, PHASE_NB };
+
+struct PhaseStats {
+  uint64_t calls;
+  uint64_t time;  // In nanoseconds (only measured when profiling)
+  uint64_t nodes;
+  uint64_t saturations;
+  uint64_t rounds;  // Saturation rounds
+  uint64_t ttHits;
+  uint64_t counters[PERF::EVENT_NB];  // Hardware events (-perfcounters)
+};
+
+const char* phase_name(Phase phase);
+
+// Prints the statistics of the phases that were run (see
+// Search::print_phases), with the hardware counters if [counters]
+void print_phases(std::ostream& os, const PhaseStats stats[PHASE_NB],
+                  bool counters);
+
 constexpr int MAX_VARIATION_LENGTH = 2000;
 
 // Search class stores information relative to the helpmate search
@@ -39,13 +71,28 @@ class Search {
   void set(Depth maxDepth, Depth initDepth, uint64_t localNodesLimit);
 
   void set_limit(uint64_t nodesLimit);
+  void set_time_limit(uint64_t microseconds);
+  void set_cancel_flag(const std::atomic<bool>* cancelFlag);
+  void set_profiling(bool enabled);
+  void set_perf_counters(bool enabled);
+  void set_tracer(TRACE::Tracer* searchTracer);
+  void set_pruning(bool enabled);
   void set_winner(Color intendedWinner);
+  void set_tt(TranspositionTable* transpositionTable, size_t mbSize = 0);
+  void clear_tt();
 
   Color intended_winner() const;
   Depth actual_depth() const;
+  Depth root_depth() const;
   Depth max_depth() const;
+  bool covers(int ply, Depth d, bool progress, bool semiBlocked) const;
+  TranspositionTable& tt() const;
+  TRACE::Tracer* tracer() const;
+  bool is_pruning() const;
 
+  StateInfo& root_state(size_t ply);
   void annotate_move(Move m);
+  void annotate_depth(Depth d, bool progress, bool semiBlocked);
   void increase_cnt();
   void step();
   void undo_step();
@@ -54,24 +101,47 @@ class Search {
   void set_undetermined();
   void set_flag(SearchFlag searchFlag);
   void interrupt();
+  void count_tt_hit();
+  void begin_phase(Phase phase);
+  void end_phase();
+  void reset_stats();
 
   bool is_interrupted() const;
   bool is_local_limit_reached() const;
   bool is_limit_reached() const;
+  bool is_timed_out() const;
+  bool is_cancelled() const;
+  bool must_stop() const;
+  const std::atomic<bool>* cancel_flag() const;
 
   SearchResult get_result() const;
   SearchFlag get_flag() const;
   uint64_t get_limit() const;
   uint64_t get_nb_nodes() const;
+  const PhaseStats& get_phase_stats(Phase phase) const;
 
-  void print_result() const;
+  void print_result(std::ostream& os = std::cout) const;
+  void print_phases(std::ostream& os = std::cout) const;
 
  private:
   // Data members
-  Move checkmateSequence[MAX_VARIATION_LENGTH];
+  // The current path of the search: the move and the arguments of find_mate
+  // (depth, pastProgress and wasSemiBlocked) at every ply (the moves are the
+  // mating sequence once a mate is found). It grows on demand, up to
+  // MAX_VARIATION_LENGTH plies.
+  struct PathEntry {
+    Move move;
+    Depth depth;
+    bool progress;
+    bool semiBlocked;
+  };
+
+  std::vector<PathEntry> path;
+  PathEntry& path_entry(int ply);
   Color winner;
 
   Depth depth;
+  Depth rootDepth;  // The ply of the root of the current find_mate
   Depth maxSearchDepth;
   Depth mateLen;
   SearchResult result;
@@ -81,17 +151,56 @@ class Search {
   uint64_t totalCounter;
   uint64_t localLimit;
   uint64_t globalLimit;
+
+  // Wall-clock budget, checked every 1024 nodes (see increase_cnt)
+  bool hasDeadline = false;
+  bool timedOut = false;
+  std::chrono::microseconds timeLimit{0};
+  std::chrono::steady_clock::time_point deadline;
+
+  // Set from another thread to abort the analysis
+  const std::atomic<bool>* cancel = nullptr;
+
+  // Semistatic pruning in find_mate, only disabled to test its soundness
+  bool pruning = true;
+
+  // Instrumentation, accumulated until reset_stats() is called. Counters are
+  // snapshot by begin_phase() and the differences added by end_phase().
+  bool profiling = false;
+  Phase phase;
+  PhaseStats snapshot;
+  std::chrono::steady_clock::time_point phaseStart;
+  uint64_t ttHits = 0;
+  PhaseStats phaseStats[PHASE_NB] = {};
+
+  // Hardware counters of the thread running the search, if enabled
+  PERF::Group* perf = nullptr;
+
+  // Records samples of the search tree of find_mate, if set
+  TRACE::Tracer* trace = nullptr;
+
+  // The states of the moves made at the root of the analyses (trivial
+  // progress), allocated on demand and reused by the following analyses
+  std::vector<std::unique_ptr<StateInfo>> rootStates;
+
+  // Each thread running searches concurrently must have its own table, which
+  // is only allocated (with ttSize MB) the first time it is needed
+  TranspositionTable* table = &TT;
+  size_t ttSize = 0;
 };
 
 inline void Search::init() {
   totalCounter = 0;
   counter = 0;
   flag = PRE_STATIC;
+  timedOut = false;
+  if (hasDeadline) deadline = std::chrono::steady_clock::now() + timeLimit;
 }
 
 inline void Search::set(Depth maxDepth, Depth initDepth,
                         uint64_t localNodesLimit) {
   depth = initDepth;
+  rootDepth = initDepth;
   maxSearchDepth = maxDepth;
   mateLen = 0;
   result = UNDETERMINED;
@@ -99,25 +208,108 @@ inline void Search::set(Depth maxDepth, Depth initDepth,
   localLimit = localNodesLimit;
   totalCounter += counter;
   counter = 0;
+  if (trace) trace->start();
 }
 
 inline void Search::set_limit(uint64_t nodesLimit) { globalLimit = nodesLimit; }
 
+// Once [*cancelFlag] is set (from any thread), the analysis unwinds as soon as
+// possible and the result is CANCELLED (unless it was already decided). Pass
+// nullptr to remove the flag.
+
+inline void Search::set_cancel_flag(const std::atomic<bool>* cancelFlag) {
+  cancel = cancelFlag;
+}
+
+// Every analysis (see init()) must end [microseconds] after it starts (0 means
+// no deadline)
+
+inline void Search::set_time_limit(uint64_t microseconds) {
+  hasDeadline = microseconds > 0;
+  timeLimit = std::chrono::microseconds(microseconds);
+}
+
 inline void Search::set_winner(Color intendedWinner) {
   winner = intendedWinner;
 }
 
+inline void Search::set_tt(TranspositionTable* transpositionTable,
+                           size_t mbSize) {
+  table = transpositionTable;
+  ttSize = mbSize;
+}
+
+// Resizing also clears the table
+inline void Search::clear_tt() {
+  if (ttSize) {
+    table->resize(ttSize);
+    ttSize = 0;
+  } else
+    table->clear();
+}
+
 inline Color Search::intended_winner() const { return winner; }
 
 inline Depth Search::actual_depth() const { return depth; }
 
+inline Depth Search::root_depth() const { return rootDepth; }
+
 inline Depth Search::max_depth() const { return maxSearchDepth; }
 
+inline TranspositionTable& Search::tt() const { return *table; }
+
+inline void Search::set_tracer(TRACE::Tracer* searchTracer) {
+  trace = searchTracer;
+}
+
+inline TRACE::Tracer* Search::tracer() const { return trace; }
+
+inline void Search::set_pruning(bool enabled) { pruning = enabled; }
+
+inline bool Search::is_pruning() const { return pruning; }
+
+inline StateInfo& Search::root_state(size_t ply) {
+  while (rootStates.size() <= ply) rootStates.emplace_back(new StateInfo());
+  return *rootStates[ply];
+}
+
+inline Search::PathEntry& Search::path_entry(int ply) {
+  if (size_t(ply) >= path.size()) path.resize(ply + 1);
+  return path[ply];
+}
+
 inline void Search::annotate_move(Move m) {
-  if (depth < MAX_VARIATION_LENGTH) checkmateSequence[depth] = m;
+  if (depth < MAX_VARIATION_LENGTH) path_entry(depth).move = m;
+}
+
+inline void Search::annotate_depth(Depth d, bool progress, bool semiBlocked) {
+  if (depth < MAX_VARIATION_LENGTH) {
+    PathEntry& entry = path_entry(depth);
+    entry.depth = d;
+    entry.progress = progress;
+    entry.semiBlocked = semiBlocked;
+  }
+}
+
+// Whether find_mate at [ply] of the current path explores (at least) the tree
+// of a call at depth [d] with the given flags: it had the same flags and no
+// more depth. Unknown plies (beyond the maximum variation length) do not.
+inline bool Search::covers(int ply, Depth d, bool progress,
+                           bool semiBlocked) const {
+  return size_t(ply) < path.size() && path[ply].depth <= d &&
+         path[ply].progress == progress &&
+         path[ply].semiBlocked == semiBlocked;
 }
 
-inline void Search::increase_cnt() { counter++; }
+inline void Search::increase_cnt() {
+  counter++;
+
+  // Reading the clock is not free, do it only once in a while (counting the
+  // nodes of the whole analysis, since set() resets the local counter)
+  if (hasDeadline && !((totalCounter + counter) & 1023) &&
+      std::chrono::steady_clock::now() > deadline)
+    timedOut = true;
+}
 
 inline void Search::step() { depth++; }
 
@@ -136,17 +328,38 @@ inline void Search::set_flag(SearchFlag searchFlag) { flag = searchFlag; }
 
 inline void Search::interrupt() { interrupted = true; }
 
+inline void Search::count_tt_hit() { ttHits++; }
+
+inline void Search::set_profiling(bool enabled) { profiling = enabled; }
+
+inline void Search::reset_stats() {
+  for (PhaseStats& stats : phaseStats) stats = PhaseStats();
+}
+
 inline bool Search::is_interrupted() const { return interrupted; }
 
 inline bool Search::is_local_limit_reached() const {
-  return counter > maxSearchDepth * localLimit;
+  return counter > maxSearchDepth * localLimit || must_stop();
 }
 
 inline bool Search::is_limit_reached() const {
-  return totalCounter > globalLimit;
+  return totalCounter > globalLimit || must_stop();
 }
 
-inline SearchResult Search::get_result() const { return result; }
+inline bool Search::is_timed_out() const { return timedOut; }
+
+inline bool Search::is_cancelled() const {
+  return cancel && cancel->load(std::memory_order_relaxed);
+}
+
+// Whether the analysis must be abandoned (out of time or cancelled)
+inline bool Search::must_stop() const { return timedOut || is_cancelled(); }
+
+inline const std::atomic<bool>* Search::cancel_flag() const { return cancel; }
+
+inline SearchResult Search::get_result() const {
+  return (result == UNDETERMINED && is_cancelled()) ? CANCELLED : result;
+}
 
 inline uint64_t Search::get_limit() const { return globalLimit; }
 
@@ -154,12 +367,29 @@ inline uint64_t Search::get_nb_nodes() const { return totalCounter + counter; }
 
 inline SearchFlag Search::get_flag() const { return flag; }
 
+inline const PhaseStats& Search::get_phase_stats(Phase p) const {
+  return phaseStats[p];
+}
+
 SearchResult full_analysis(Position&, Search&);
 
+// dead_analysis() is full_analysis for both players at once: WHITE with the
+// first search and BLACK with the second one (which must have their own
+// transposition tables). It is UNWINNABLE if the position is dead, WINNABLE
+// if some player can win and UNDETERMINED otherwise.
+SearchResult dead_analysis(Position&, Search& white, Search& black);
+
 SearchResult quick_analysis(Position&, Search&, bool stable);
 
 SearchResult find_shortest(Position&, Search&);
 
+// Single kernels of the above analyses, exposed for microbenchmarking (see
+// microbench.cpp). The search is reset, but its result must not be trusted.
+
+bool find_mate_at_depth(Position&, Search&, Depth depth);
+
+bool exhaustive_search(Position&, Search&, Depth depth);
+
 }  // namespace DYNAMIC
 
 #endif  // #ifndef DYNAMIC_H_INCLUDED
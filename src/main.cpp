@@ -20,139 +20,215 @@
 #include "semistatic.h"
 #include "dynamic.h"
 #include "cha.h"
+#include "query.h"
+#include "pipeline.h"
+#include "server.h"
+#include "stats.h"
 #include <sstream>
 #include <fstream>
-#include <math.h>
-
-// We expect input commands to be a line of text containing a FEN followed by
-// the intended winner ('white' or 'black') or nothing (the default intended
-// winner is the last player who moved)
-
-Color parse_line(Position& pos, StateInfo* si, std::string& line) {
-  std::string fen, token;
-  std::istringstream iss(line);
-
-  while (iss >> token && token != "black" && token != "white")
-    fen += token + " ";
-
-  pos.set(fen, false, si, Threads.main());
-
-  if (token == "white")
-    return WHITE;
-
-  else if (token == "black")
-    return BLACK;
-
-  else
-    return ~pos.side_to_move();
-}
+#include <memory>
+#include <chrono>
 
 // loop() waits for a command from stdin or tests file and analyzes it.
 
 void loop(int argc, char* argv[]) {
   CHA::init();
 
-  Position pos;
-  std::string token, line;
-  StateListPtr states(new std::deque<StateInfo>(1));
+  std::string line;
   bool runningTests = false;
-  bool skipWinnable = false;
-  bool findShortest = false;
-  bool quickAnalysis = false;
-  bool adjudicateTimeout = false;
-  uint64_t globalLimit = 500000;
+  int nbThreads = 0;  // Not given
+  std::string socketPath;
+  std::string histogramFile;
+  std::string reportFile;
+  std::string slowLogFile;
+  std::string traceFile;
+  std::string traceFormat = "collapsed";
+  QUERY::Settings settings;
 
   for (int i = 1; i < argc; ++i) {
     if (std::string(argv[i]) == "test") {
       runningTests = true;
-      quickAnalysis = true;
+      settings.mode = QUERY::QUICK;
     }
 
-    if (std::string(argv[i]) == "-u") skipWinnable = true;
+    if (std::string(argv[i]) == "-u") settings.skipWinnable = true;
 
-    if (std::string(argv[i]) == "-min") findShortest = true;
+    if (std::string(argv[i]) == "-quick") settings.mode = QUERY::QUICK;
 
-    if (std::string(argv[i]) == "-quick") quickAnalysis = true;
+    if (std::string(argv[i]) == "-tiered") settings.mode = QUERY::TIERED;
 
-    if (std::string(argv[i]) == "-timeout") adjudicateTimeout = true;
+    if (std::string(argv[i]) == "-timeout") settings.adjudicateTimeout = true;
+
+    if (std::string(argv[i]) == "-phases") settings.reportPhases = true;
+
+    if (std::string(argv[i]) == "-histogram") {
+      histogramFile = argv[i + 1];
+      settings.profiling = true;
+    }
+
+    if (std::string(argv[i]) == "-perfcounters") {
+      settings.perfCounters = true;
+      settings.profiling = true;
+    }
+
+    if (std::string(argv[i]) == "-slowlog") {
+      slowLogFile = argv[i + 1];
+      settings.profiling = true;
+    }
+
+    if (std::string(argv[i]) == "-slowtime") {
+      std::istringstream iss(argv[i + 1]);
+      iss >> settings.slowTime;
+    }
+
+    if (std::string(argv[i]) == "-slownodes") {
+      std::istringstream iss(argv[i + 1]);
+      iss >> settings.slowNodes;
+    }
+
+    if (std::string(argv[i]) == "-trace") {
+      traceFile = argv[i + 1];
+      settings.tracing = true;
+    }
+
+    if (std::string(argv[i]) == "-trace-format") traceFormat = argv[i + 1];
+
+    if (std::string(argv[i]) == "-trace-sample") {
+      std::istringstream iss(argv[i + 1]);
+      iss >> settings.traceSample;
+    }
+
+    if (std::string(argv[i]) == "-report") reportFile = argv[i + 1];
 
     if (std::string(argv[i]) == "-limit") {
       std::istringstream iss(argv[i + 1]);
-      iss >> globalLimit;
+      iss >> settings.globalLimit;
+    }
+
+    if (std::string(argv[i]) == "-deadline") {
+      std::istringstream iss(argv[i + 1]);
+      iss >> settings.timeLimit;
     }
+
+    if (std::string(argv[i]) == "-quick-deadline") {
+      std::istringstream iss(argv[i + 1]);
+      iss >> settings.quickTimeLimit;
+    }
+
+    if (std::string(argv[i]) == "-deep-limit") {
+      std::istringstream iss(argv[i + 1]);
+      iss >> settings.deepLimit;
+    }
+
+    if (std::string(argv[i]) == "-deep-deadline") {
+      std::istringstream iss(argv[i + 1]);
+      iss >> settings.deepTimeLimit;
+    }
+
+    if (std::string(argv[i]) == "-threads") {
+      std::istringstream iss(argv[i + 1]);
+      iss >> nbThreads;
+    }
+
+    if (std::string(argv[i]) == "-serve" || std::string(argv[i]) == "--serve")
+      socketPath = argv[i + 1];
+  }
+
+  // [-min] takes precedence over [-quick]
+  for (int i = 1; i < argc; ++i)
+    if (std::string(argv[i]) == "-min") settings.mode = QUERY::SHORTEST;
+
+  if (!socketPath.empty()) {
+    if (nbThreads <= 0)
+      nbThreads = std::max(1, int(std::thread::hardware_concurrency()));
+
+    SERVER::serve(socketPath, settings, nbThreads);
+    Threads.stop = true;
+    return;
+  }
+
+  // Without explicit thresholds, positions over 100 ms are logged
+  std::ofstream slowLog;
+  if (!slowLogFile.empty()) {
+    slowLog.open(slowLogFile, std::ios::app);
+    if (!settings.slowTime && !settings.slowNodes)
+      settings.slowTime = 100 * 1000;
   }
 
-  static DYNAMIC::Search search = DYNAMIC::Search();
-  search.set_limit(globalLimit);
+  // Traces of undetermined queries, one process per query in chrome format
+  std::ofstream trace;
+  bool chromeTrace = traceFormat == "chrome";
+  int tracedQueries = 0;
+  if (!traceFile.empty()) {
+    trace.open(traceFile);
+    if (chromeTrace) TRACE::begin_chrome(trace);
+  }
 
   std::ifstream infile("../tests/lichess-30K-games.txt");
+  std::istream& in = runningTests ? infile : std::cin;
 
-  uint64_t totalPuzzles = 0;
-  uint64_t totalTime = 0;
-  uint64_t maxTime = 0;
-  uint64_t totalTimeSquared = 0;
+  std::unique_ptr<STATS::Summary> summary(new STATS::Summary());
+  uint64_t decidedBy[4] = {0, 0, 0, 0};  // Per tier, in TIERED mode
 
-  while (runningTests ? getline(infile, line) : getline(std::cin, line)) {
-    if (line == "quit") break;
+  auto start = std::chrono::steady_clock::now();
 
-    DYNAMIC::SearchResult result;
-    Color winner = parse_line(pos, &states->back(), line);
-    search.set_winner(winner);
-    StateInfo st;
+  auto write = [&](const std::string& query, const QUERY::Answer& answer) {
+    if (!answer.output.empty()) std::cout << answer.output << std::endl;
 
-    auto start = std::chrono::high_resolution_clock::now();
+    if (!answer.valid) return;
 
-    if (findShortest)
-      result = DYNAMIC::find_shortest(pos, search);
+    if (!answer.slowEntry.empty() && slowLog.is_open())
+      slowLog << answer.slowEntry << std::endl;
 
-    else if (quickAnalysis)
-      result = DYNAMIC::quick_analysis(pos, search, false);
+    if (!answer.trace.empty() && trace.is_open()) {
+      if (chromeTrace)
+        TRACE::write_chrome(trace, ++tracedQueries, query, answer.trace);
+      else
+        TRACE::write_collapsed(trace, query, answer.trace);
+    }
 
-    else
-      result = DYNAMIC::full_analysis(pos, search);
+    decidedBy[answer.tier]++;
+    summary->add(answer);
+  };
 
-    auto stop = std::chrono::high_resolution_clock::now();
-    auto diff =
-        std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
-    uint64_t duration = diff.count();
+  if (nbThreads > 1)
+    PIPELINE::run(in, settings, nbThreads, PIPELINE::DEFAULT_WINDOW, write);
 
-    if (adjudicateTimeout) {
-      if (result == DYNAMIC::UNWINNABLE)
-        std::cout << "1/2-1/2" << std::endl;
+  else {
+    std::unique_ptr<QUERY::Context> ctx(new QUERY::Context());
+    ctx->init(settings);
+    QUERY::Answer answer;
 
-      else if (winner == WHITE)
-        std::cout << "1-0" << std::endl;
+    while (getline(in, line)) {
+      if (line == "quit") break;
 
-      else
-        std::cout << "0-1" << std::endl;
-    } else {
-      // On quick mode, we only print [unwinnable] ([undetermined] are all
-      // guessed to be [winnable]).
-      // On full mode, we print all cases except possibly [winnable].
-      if ((!quickAnalysis || result == DYNAMIC::UNWINNABLE) &&
-          (!skipWinnable || result != DYNAMIC::WINNABLE)) {
-        search.print_result();
-        std::cout << " time " << duration / 1000 << " (" << line << ")" << std::endl;
-      }
-
-      // if (duration > 100 * 1000 * 1000)
-      // std::cout << "Hard: " << line << std::endl;
-    }
-
-    totalPuzzles++;
-    totalTime += duration;
-    totalTimeSquared += duration * duration;
-    if (duration > maxTime) maxTime = duration;
+      QUERY::analyze(*ctx, line, settings, answer);
+      write(line, answer);
+    }
   }
 
-  uint64_t avg = totalTime / totalPuzzles;
-  uint64_t variance = (totalTimeSquared / totalPuzzles) - (avg * avg);
+  uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+  if (trace.is_open() && chromeTrace) TRACE::end_chrome(trace);
+
+  summary->print(std::cout);
+
+  if (!reportFile.empty()) {
+    std::ofstream report(reportFile);
+    summary->report(report, elapsed);
+  }
+
+  if (!histogramFile.empty()) {
+    std::ofstream histogram(histogramFile);
+    summary->dump(histogram);
+  }
 
-  std::cout << "Analyzed " << totalPuzzles << " "
-            << "positions in " << totalTime / 1000 / 1000 << " ms "
-            << "(avg: " << avg / 1000.0 << " us; "
-            << "std: " << sqrt(variance) / 1000 << " us; "
-            << "max: " << maxTime / 1000 << " us)" << std::endl;
+  if (settings.mode == QUERY::TIERED)
+    std::cout << "Decided by tier: quick " << decidedBy[QUERY::QUICK_TIER]
+              << ", full " << decidedBy[QUERY::FULL_TIER] << ", deep "
+              << decidedBy[QUERY::DEEP_TIER] << std::endl;
 
   Threads.stop = true;
 }
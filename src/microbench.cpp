@@ -0,0 +1,275 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#include "stockfish.h"
+#include "util.h"
+#include "semistatic.h"
+#include "dynamic.h"
+#include "cha.h"
+#include <sched.h>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Microbenchmarks of the hot kernels of the analysis, each one measured in
+// isolation over a fixed corpus of positions. Every kernel is run once over
+// the whole corpus (warmup) and then repeatedly, until a minimum time has
+// elapsed. The process is pinned to a single CPU, so that the cycle counter
+// is consistent and the caches are not lost to migrations.
+//
+// Usage: microbench [corpus] [-cpu N] [-time ms] [-depth N] [-only kernel]
+//                   [-frontier scalar|avx2]
+//
+// The corpus defaults to ../tests/test-vector.txt; lines starting with '#'
+// are ignored, and so are the expected results of the test vectors.
+
+namespace {
+
+struct Corpus {
+  std::deque<StateInfo> states;
+  std::vector<std::unique_ptr<Position>> positions;
+};
+
+void load(Corpus& corpus, std::istream& in) {
+  std::string line, token, fen;
+
+  while (getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+
+    std::istringstream iss(line);
+    fen.clear();
+
+    // Skip the expected results of the test vectors, e.g. "W-"
+    while (iss >> token && token.find('/') == std::string::npos)
+      continue;
+
+    do
+      fen += token + " ";
+    while (iss >> token);
+
+    corpus.states.emplace_back();
+    corpus.positions.emplace_back(new Position());
+    corpus.positions.back()->set(fen, false, &corpus.states.back(),
+                                 Threads.main());
+  }
+}
+
+inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// Keeps the compiler from discarding the results of the kernels
+volatile uint64_t Sink;
+
+// [kernel] is called once per position and returns the number of calls it
+// performed (some kernels are cheap enough to be called several times)
+
+typedef std::function<uint64_t(Position&)> Kernel;
+
+void measure(const std::string& name, Corpus& corpus, const Kernel& kernel,
+             uint64_t minTime) {
+  for (auto& pos : corpus.positions) kernel(*pos);
+
+  uint64_t calls = 0;
+  uint64_t elapsed = 0;
+  uint64_t nbCycles = 0;
+
+  while (elapsed < minTime * 1000 * 1000) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t startCycles = cycles();
+
+    for (auto& pos : corpus.positions) calls += kernel(*pos);
+
+    nbCycles += cycles() - startCycles;
+    elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+  }
+
+  std::cout << "kernel " << name << " calls " << calls << " ns/call "
+            << double(elapsed) / calls << " cycles/call "
+            << double(nbCycles) / calls << std::endl;
+}
+
+void pin(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  if (sched_setaffinity(0, sizeof(set), &set) != 0)
+    std::cerr << "Could not pin the process to CPU " << cpu << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  init_stockfish();
+  CommandLine::init(argc, argv);
+  CHA::init();
+
+  std::string corpusFile = "../tests/test-vector.txt";
+  std::string only;
+  int cpu = 0;
+  uint64_t minTime = 500;  // In milliseconds, per kernel
+  Depth depth = 2;
+  SemiStatic::Kernel frontier = SemiStatic::best_kernel();
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+
+    if (arg == "-cpu" && i + 1 < argc)
+      cpu = atoi(argv[++i]);
+
+    else if (arg == "-time" && i + 1 < argc)
+      minTime = atoi(argv[++i]);
+
+    else if (arg == "-depth" && i + 1 < argc)
+      depth = atoi(argv[++i]);
+
+    else if (arg == "-only" && i + 1 < argc)
+      only = argv[++i];
+
+    else if (arg == "-frontier" && i + 1 < argc)
+      frontier = std::string(argv[++i]) == "scalar" ? SemiStatic::SCALAR
+                                                    : SemiStatic::AVX2;
+
+    else
+      corpusFile = arg;
+  }
+
+  pin(cpu);
+
+  // Unsupported kernels fall back to the scalar one
+  if (frontier != SemiStatic::best_kernel()) frontier = SemiStatic::SCALAR;
+
+  Corpus corpus;
+  std::ifstream in(corpusFile);
+  load(corpus, in);
+
+  if (corpus.positions.empty()) {
+    std::cerr << "Empty corpus: " << corpusFile << std::endl;
+    return 1;
+  }
+
+  std::cout << "Corpus " << corpusFile << " (" << corpus.positions.size()
+            << " positions), CPU " << cpu << ", "
+            << SemiStatic::kernel_name(frontier) << " frontier" << std::endl;
+
+  std::unique_ptr<SemiStatic::System> system(new SemiStatic::System());
+  system->set_kernel(frontier);
+  std::unique_ptr<SemiStatic::Batch> batch(new SemiStatic::Batch());
+  std::unique_ptr<DYNAMIC::Search> search(new DYNAMIC::Search());
+  search->set_limit(5000);  // As in the probe of the full analysis
+
+  // The intended winner is the last player to make a move, as in cha
+  auto set_winner = [&](Position& pos) {
+    search->set_winner(~pos.side_to_move());
+  };
+
+  std::vector<std::pair<std::string, Kernel>> kernels = {
+      {"saturate",
+       [&](Position& pos) {
+         Sink = system->saturate(pos);
+         return 1;
+       }},
+      {"saturate_cached",
+       [&](Position& pos) {
+         Sink = system->saturate_cached(pos);
+         return 1;
+       }},
+      {"saturate_children",
+       [&](Position& pos) {
+         // One call per child, all saturated together
+         StateInfo st;
+         batch->clear();
+         for (const auto& m : MoveList<LEGAL>(pos)) {
+           pos.do_move(m, st);
+           batch->add(pos);
+           pos.undo_move(m);
+         }
+         Sink = batch->saturate();
+         return batch->size();
+       }},
+      {"is_unwinnable",
+       [&](Position& pos) {
+         system->saturate_cached(pos);
+         Sink = system->is_unwinnable(pos, ~pos.side_to_move());
+         return 1;
+       }},
+      {"find_mate_at_depth",
+       [&](Position& pos) {
+         set_winner(pos);
+         Sink = DYNAMIC::find_mate_at_depth(pos, *search, depth);
+         return 1;
+       }},
+      {"exhaustive_search_7",
+       [&](Position& pos) {
+         set_winner(pos);
+         Sink = DYNAMIC::exhaustive_search(pos, *search, 7);
+         return 1;
+       }},
+      {"has_lonely_pawns",
+       [&](Position& pos) {
+         Sink = UTIL::has_lonely_pawns(pos);
+         return 1;
+       }},
+      {"semi_blocked_target",
+       [&](Position& pos) {
+         Square target = SQ_NONE;
+         Sink = UTIL::semi_blocked_target(pos, target) + target;
+         return 1;
+       }},
+      {"neighbours_distance_2",
+       [&](Position& pos) {
+         Sink = UTIL::neighbours_distance_2(pos.square<KING>(WHITE)) ^
+                UTIL::neighbours_distance_2(pos.square<KING>(BLACK));
+         return 2;
+       }},
+      {"find_king",
+       [&](Position& pos) {
+         Sink = UTIL::find_king(pos, WHITE) + UTIL::find_king(pos, BLACK);
+         return 2;
+       }},
+      {"knight_distance",
+       [&](Position& pos) {
+         // From every square to both kings
+         Square wk = pos.square<KING>(WHITE);
+         Square bk = pos.square<KING>(BLACK);
+         uint64_t sum = 0;
+         for (Square s = SQ_A1; s <= SQ_H8; ++s)
+           sum += KnightDistance::get(s, wk) + KnightDistance::get(s, bk);
+         Sink = sum;
+         return 128;
+       }},
+  };
+
+  for (auto& k : kernels)
+    if (only.empty() || only == k.first)
+      measure(k.first, corpus, k.second, minTime);
+
+  Threads.stop = true;
+  return 0;
+}
@@ -0,0 +1,141 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#include "perf.h"
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* PERF::event_name(Event event) {
+  static const char* names[EVENT_NB] = {"cycles", "instructions", "l1dmisses",
+                                        "llcmisses", "branchmisses"};
+  return names[event];
+}
+
+#ifdef __linux__
+
+namespace {
+
+// Counts user-space events of the calling thread, on any CPU
+
+int open_event(uint32_t type, uint64_t config, int groupFd) {
+  perf_event_attr attr = {};
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = groupFd == -1;  // The leader starts the whole group
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+
+  return int(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+constexpr uint64_t cache_config(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+}  // namespace
+
+// The group is led by the cycles counter: without it there is nothing to
+// report. The other events are optional (e.g. under virtualization).
+
+bool PERF::Group::open() {
+  const uint32_t types[EVENT_NB] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                    PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+                                    PERF_TYPE_HARDWARE};
+  const uint64_t configs[EVENT_NB] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      cache_config(PERF_COUNT_HW_CACHE_L1D), cache_config(PERF_COUNT_HW_CACHE_LL),
+      PERF_COUNT_HW_BRANCH_MISSES};
+
+  int nbOpen = 0;
+
+  for (int e = 0; e < EVENT_NB; ++e) {
+    fds[e] = open_event(types[e], configs[e], fds[CYCLES]);
+    order[e] = fds[e] == -1 ? -1 : nbOpen++;
+
+    if (fds[CYCLES] == -1) return false;
+  }
+
+  ioctl(fds[CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(fds[CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+PERF::Group::~Group() {
+  for (int e = 0; e < EVENT_NB; ++e)
+    if (fds[e] != -1) close(fds[e]);
+}
+
+// A group read is { nr, value[nr] } (the group has no more than EVENT_NB
+// events, so it is never multiplexed on machines with enough counters)
+
+void PERF::Group::read(uint64_t values[EVENT_NB]) const {
+  uint64_t buffer[1 + EVENT_NB] = {};
+
+  if (fds[CYCLES] == -1 || ::read(fds[CYCLES], buffer, sizeof(buffer)) <= 0)
+    buffer[0] = 0;
+
+  for (int e = 0; e < EVENT_NB; ++e)
+    values[e] = order[e] != -1 && order[e] < int(buffer[0])
+                    ? buffer[1 + order[e]]
+                    : 0;
+}
+
+PERF::Group* PERF::thread_group() {
+  static thread_local std::unique_ptr<Group> group;
+  static thread_local bool tried = false;
+  static std::once_flag warning;
+
+  if (!tried) {
+    tried = true;
+    group.reset(new Group());
+
+    if (!group->open()) {
+      group.reset();
+      std::call_once(warning, [] {
+        std::cerr << "Hardware performance counters are not available"
+                  << std::endl;
+      });
+    }
+  }
+
+  return group.get();
+}
+
+#else
+
+bool PERF::Group::open() { return false; }
+
+PERF::Group::~Group() {}
+
+void PERF::Group::read(uint64_t values[EVENT_NB]) const {
+  for (int e = 0; e < EVENT_NB; ++e) values[e] = 0;
+}
+
+PERF::Group* PERF::thread_group() { return nullptr; }
+
+#endif
@@ -0,0 +1,63 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#ifndef PERF_H_INCLUDED
+#define PERF_H_INCLUDED
+
+#include <cstdint>
+
+namespace PERF {
+
+// Hardware events counted in -perfcounters mode (Linux only)
+
+enum Event {
+  CYCLES,
+  INSTRUCTIONS,
+  L1D_MISSES,
+  LLC_MISSES,
+  BRANCH_MISSES,
+  EVENT_NB
+};
+
+const char* event_name(Event event);
+
+// A group of hardware counters of the calling thread (perf_event_open), read
+// all at once. Events that the machine does not support read as 0.
+
+class Group {
+ public:
+  Group() = default;
+  Group(const Group&) = delete;
+  ~Group();
+
+  bool open();
+  void read(uint64_t values[EVENT_NB]) const;
+
+ private:
+  int fds[EVENT_NB] = {-1, -1, -1, -1, -1};
+  int order[EVENT_NB];  // Position of every event in a read of the group
+};
+
+// The group of the calling thread, opened on first use. It is nullptr if the
+// counters are not available (not Linux, or not allowed by
+// /proc/sys/kernel/perf_event_paranoid).
+
+Group* thread_group();
+
+}  // namespace PERF
+
+#endif  // #ifndef PERF_H_INCLUDED
@@ -0,0 +1,203 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#include "stockfish.h"
+#include "dynamic.h"
+#include "query.h"
+#include "pipeline.h"
+#include <limits>
+
+void PIPELINE::wait(int& spins) {
+  spins++;
+  if (spins < 64)
+    return;
+
+  else if (spins < 1024)
+    std::this_thread::yield();
+
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+namespace {
+
+// A slot of the reorder window. The query with sequence number [seq] goes to
+// slot [seq % window]; [done] is set by the analyzer once it is answered and
+// cleared by the writer once it has been reported.
+
+struct Job {
+  std::string line;
+  QUERY::Answer answer;
+  std::atomic<bool> done;
+};
+
+}  // namespace
+
+void PIPELINE::run(std::istream& in, const QUERY::Settings& settings,
+                   int nbAnalyzers, size_t window, const Writer& write) {
+  std::unique_ptr<Job[]> jobs(new Job[window]);
+  BoundedQueue<Job*> queue(window);
+  size_t mask = window - 1;
+
+  const uint64_t NO_TOTAL = std::numeric_limits<uint64_t>::max();
+  std::atomic<uint64_t> written(0);  // Number of queries already reported
+  std::atomic<uint64_t> total(NO_TOTAL);  // Known once the input is over
+
+  for (size_t i = 0; i < window; ++i) jobs[i].done = false;
+
+  std::thread reader([&]() {
+    std::string line;
+    uint64_t seq = 0;
+
+    while (getline(in, line)) {
+      if (line == "quit") break;
+
+      // Backpressure: do not overwrite a slot that has not been reported yet
+      int spins = 0;
+      while (seq - written.load(std::memory_order_acquire) >= window)
+        wait(spins);
+
+      Job& job = jobs[seq & mask];
+      job.line = line;
+      queue.push(&job);
+      seq++;
+    }
+
+    total.store(seq, std::memory_order_release);
+
+    // Tell the analyzers that there is no more work
+    for (int i = 0; i < nbAnalyzers; ++i) queue.push(nullptr);
+  });
+
+  std::vector<std::thread> analyzers;
+  for (int i = 0; i < nbAnalyzers; ++i)
+    analyzers.emplace_back([&]() {
+      std::unique_ptr<QUERY::Context> ctx(new QUERY::Context());
+      ctx->init(settings);
+
+      Job* job;
+      while (queue.pop(job), job != nullptr) {
+        QUERY::analyze(*ctx, job->line, settings, job->answer);
+        job->done.store(true, std::memory_order_release);
+      }
+    });
+
+  // The writer: report the answers in order
+  for (uint64_t seq = 0;; ++seq) {
+    Job& job = jobs[seq & mask];
+
+    int spins = 0;
+    bool over = false;
+    while (!job.done.load(std::memory_order_acquire) && !over) {
+      over = seq >= total.load(std::memory_order_acquire);
+      if (!over) wait(spins);
+    }
+
+    if (over) break;
+
+    write(job.line, job.answer);
+    job.done.store(false, std::memory_order_relaxed);
+    written.store(seq + 1, std::memory_order_release);
+  }
+
+  reader.join();
+  for (std::thread& th : analyzers) th.join();
+}
+
+PIPELINE::Pool::Pool(const QUERY::Settings& poolSettings, int nbAnalyzers)
+    : settings(poolSettings), stop(false) {
+  for (int i = 0; i < nbAnalyzers; ++i)
+    threads.emplace_back(&Pool::idle_loop, this);
+}
+
+PIPELINE::Pool::~Pool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  available.notify_all();
+
+  for (std::thread& th : threads) th.join();
+}
+
+void PIPELINE::Pool::analyze(const std::string& line, QUERY::Answer& answer,
+                             const std::function<bool()>& watch) {
+  Task task;
+  task.line = &line;
+  task.answer = &answer;
+  task.done = false;
+  task.cancelled = false;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  tasks.push_back(&task);
+  available.notify_one();
+
+  if (!watch) {
+    task.finished.wait(lock, [&]() { return task.done; });
+    return;
+  }
+
+  while (!task.finished.wait_for(lock, std::chrono::milliseconds(5),
+                                 [&]() { return task.done; }))
+    if (!task.cancelled && !watch()) task.cancelled = true;
+}
+
+void PIPELINE::Pool::analyze(const std::string* lines, QUERY::Answer* answers,
+                             size_t n) {
+  std::unique_ptr<Task[]> batch(new Task[n]);
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  for (size_t i = 0; i < n; ++i) {
+    batch[i].line = &lines[i];
+    batch[i].answer = &answers[i];
+    batch[i].done = false;
+    batch[i].cancelled = false;
+    tasks.push_back(&batch[i]);
+  }
+  available.notify_all();
+
+  for (size_t i = 0; i < n; ++i)
+    batch[i].finished.wait(lock, [&]() { return batch[i].done; });
+}
+
+void PIPELINE::Pool::idle_loop() {
+  std::unique_ptr<QUERY::Context> ctx(new QUERY::Context());
+  ctx->init(settings);
+
+  while (true) {
+    Task* task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      available.wait(lock, [&]() { return stop || !tasks.empty(); });
+
+      if (tasks.empty()) return;  // We have been stopped
+
+      task = tasks.front();
+      tasks.pop_front();
+    }
+
+    ctx->search.set_cancel_flag(&task->cancelled);
+    QUERY::analyze(*ctx, *task->line, settings, *task->answer);
+    ctx->search.set_cancel_flag(nullptr);
+
+    // Notify while holding the lock, the task lives in the caller's stack
+    std::lock_guard<std::mutex> lock(mutex);
+    task->done = true;
+    task->finished.notify_one();
+  }
+}
@@ -0,0 +1,194 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#ifndef PIPELINE_H_INCLUDED
+#define PIPELINE_H_INCLUDED
+
+#include <functional>
+
+// Queries can be answered concurrently by organizing the work in three stages:
+//
+//   reader --> [queue] --> analyzer (xN) --> [reorder window] --> writer
+//
+// A single reader thread reads the input lines, N analyzer threads (each with
+// its own QUERY::Context) answer them and the writer reports the answers in
+// the same order as the queries were read. At most [window] queries can be in
+// flight at any time: the reader waits for the writer when it gets too far
+// ahead, which keeps the memory usage bounded no matter the input size.
+
+namespace PIPELINE {
+
+constexpr size_t DEFAULT_WINDOW = 1024;  // Must be a power of 2
+
+// Wait a little, more and more as the number of [spins] grows
+void wait(int& spins);
+
+// A bounded multi-producer multi-consumer queue (after Dmitry Vyukov). Every
+// cell carries a sequence number that tells producers and consumers whether
+// the cell is ready for them, so no locks are needed. The capacity must be a
+// power of 2.
+
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity);
+
+  bool try_push(const T& value);
+  bool try_pop(T& value);
+
+  // Blocking versions (they wait while the queue is full or empty)
+  void push(const T& value);
+  void pop(T& value);
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  size_t mask;
+  alignas(64) std::atomic<size_t> enqueuePos;
+  alignas(64) std::atomic<size_t> dequeuePos;
+};
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(size_t capacity)
+    : cells(new Cell[capacity]), mask(capacity - 1) {
+  assert(capacity >= 2 && (capacity & mask) == 0);
+
+  for (size_t i = 0; i < capacity; ++i)
+    cells[i].sequence.store(i, std::memory_order_relaxed);
+
+  enqueuePos.store(0, std::memory_order_relaxed);
+  dequeuePos.store(0, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool BoundedQueue<T>::try_push(const T& value) {
+  size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+  while (true) {
+    Cell& cell = cells[pos & mask];
+    size_t seq = cell.sequence.load(std::memory_order_acquire);
+    intptr_t dif = intptr_t(seq) - intptr_t(pos);
+
+    if (dif == 0) {
+      if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+        cell.data = value;
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    }
+
+    else if (dif < 0)  // Full
+      return false;
+
+    else
+      pos = enqueuePos.load(std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+bool BoundedQueue<T>::try_pop(T& value) {
+  size_t pos = dequeuePos.load(std::memory_order_relaxed);
+
+  while (true) {
+    Cell& cell = cells[pos & mask];
+    size_t seq = cell.sequence.load(std::memory_order_acquire);
+    intptr_t dif = intptr_t(seq) - intptr_t(pos + 1);
+
+    if (dif == 0) {
+      if (dequeuePos.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+        value = cell.data;
+        cell.sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+      }
+    }
+
+    else if (dif < 0)  // Empty
+      return false;
+
+    else
+      pos = dequeuePos.load(std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+void BoundedQueue<T>::push(const T& value) {
+  int spins = 0;
+  while (!try_push(value)) wait(spins);
+}
+
+template <typename T>
+void BoundedQueue<T>::pop(T& value) {
+  int spins = 0;
+  while (!try_pop(value)) wait(spins);
+}
+
+// The writer is given every query together with its answer, in order
+typedef std::function<void(const std::string&, const QUERY::Answer&)> Writer;
+
+// PIPELINE::run() answers all the queries from [in] with [nbAnalyzers]
+// analyzer threads, the calling thread plays the role of the writer.
+void run(std::istream& in, const QUERY::Settings& settings, int nbAnalyzers,
+         size_t window, const Writer& write);
+
+// A Pool of analyzer threads, each with its own QUERY::Context, answering
+// queries submitted from any number of threads. Idle analyzers sleep, so that
+// a Pool can be kept alive while waiting for queries.
+
+class Pool {
+ public:
+  Pool(const QUERY::Settings& settings, int nbAnalyzers);
+  ~Pool();
+
+  // Answer the query [line] on some analyzer, blocks until it is done. While
+  // waiting, [watch] (if given) is called every few milliseconds, the analysis
+  // is cancelled as soon as it returns false.
+  void analyze(const std::string& line, QUERY::Answer& answer,
+               const std::function<bool()>& watch = nullptr);
+
+  // Answer the [n] queries [lines], spread over all the analyzers, blocks
+  // until all of them are done
+  void analyze(const std::string* lines, QUERY::Answer* answers, size_t n);
+
+ private:
+  struct Task {
+    const std::string* line;
+    QUERY::Answer* answer;
+    bool done;
+    std::atomic<bool> cancelled;
+    std::condition_variable finished;
+  };
+
+  void idle_loop();
+
+  // Data members
+  QUERY::Settings settings;
+  std::vector<std::thread> threads;
+  std::deque<Task*> tasks;
+  std::mutex mutex;
+  std::condition_variable available;
+  bool stop;
+};
+
+}  // namespace PIPELINE
+
+#endif  // #ifndef PIPELINE_H_INCLUDED
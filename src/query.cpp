@@ -0,0 +1,504 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#include "stockfish.h"
+#include "dynamic.h"
+#include "query.h"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <chrono>
+
+// TranspositionTable has no constructor, its first resize() frees the table
+// it holds: the tables must start empty however the Context is created
+
+QUERY::Context::Context() : thread(0), tt(), blackTT() {}
+
+void QUERY::Context::init(const Settings& settings) {
+  if (hashSize != size_t(Options["Hash"])) {
+    hashSize = size_t(Options["Hash"]);
+    search.set_tt(&tt, hashSize);
+    blackSearch.set_tt(&blackTT, hashSize);
+  }
+
+  search.set_limit(settings.globalLimit);
+}
+
+namespace {
+
+// Whether [token] ends the FEN of a query. Note that FEN fields may be "-",
+// but options are longer.
+
+bool ends_fen(const std::string& token) {
+  return token == "black" || token == "white" || token == "#" ||
+         (token.size() > 1 && token[0] == '-');
+}
+
+// Whether [token] is an option that takes a budget (a number of nodes or of
+// microseconds)
+
+bool is_budget_option(const std::string& token) {
+  return token == "-limit" || token == "-deadline" ||
+         token == "-quick-deadline" || token == "-deep-limit" ||
+         token == "-deep-deadline";
+}
+
+// Whether [token] is a non-negative integer that fits in 64 bits
+
+bool is_number(const std::string& token) {
+  if (token.empty() || token.size() > 20) return false;
+
+  for (char c : token)
+    if (c < '0' || c > '9') return false;
+
+  return token.size() < 20 || token <= "18446744073709551615";
+}
+
+// Read the value of a budget option from [iss] into [budget]. If [capped], the
+// value may not exceed the current value of [budget]. A [time] budget of 0
+// means no limit.
+
+void read_budget(std::istringstream& iss, uint64_t& budget, bool capped,
+                 bool time) {
+  uint64_t value = 0;
+  iss >> value;
+
+  if (capped && time)
+    budget = budget && (!value || value > budget) ? budget : value;
+
+  else if (capped)
+    budget = std::min(budget, value);
+
+  else
+    budget = value;
+}
+
+}  // namespace
+
+// Whether [fen] can be set up and analyzed: eight ranks of eight squares, one
+// king of each color, no pawns on the first and last ranks, a side to move,
+// and castling rights with a rook on the back rank of their color. Extra
+// fields (counters, identifiers) are not checked. Otherwise, [error] tells
+// what is wrong.
+
+bool QUERY::is_valid_fen(const std::string& fen, std::string& error) {
+  std::istringstream iss(fen);
+  std::string board, side, castling, enpassant;
+  const std::string PieceToChar("PNBRQKpnbrqk");
+  int kings[COLOR_NB] = {0, 0};
+  bool backRook[COLOR_NB] = {false, false};
+  int rank = 0, file = 0;
+
+  if (!(iss >> board)) {
+    error = "empty query";
+    return false;
+  }
+
+  for (char c : board) {
+    size_t idx;
+
+    if (c == '/') {
+      if (file != 8) break;
+      rank++;
+      file = 0;
+    } else if (c >= '1' && c <= '8')
+      file += c - '0';
+
+    else if ((idx = PieceToChar.find(c)) != std::string::npos) {
+      Color color = Color(idx / 6);
+      PieceType pt = PieceType(idx % 6 + 1);
+
+      if (pt == PAWN && (rank == 0 || rank == 7)) {
+        error = "pawn on the first or last rank";
+        return false;
+      }
+      kings[color] += pt == KING;
+      backRook[color] |= pt == ROOK && rank == (color == WHITE ? 7 : 0);
+      file++;
+    } else {
+      error = std::string("unexpected character '") + c + "' in the board";
+      return false;
+    }
+
+    if (file > 8) break;
+  }
+
+  if (rank != 7 || file != 8) {
+    error = "the board must have 8 ranks of 8 squares";
+    return false;
+  }
+
+  if (kings[WHITE] != 1 || kings[BLACK] != 1) {
+    error = "there must be one king of each color";
+    return false;
+  }
+
+  if (!(iss >> side) || (side != "w" && side != "b")) {
+    error = "the side to move must be 'w' or 'b'";
+    return false;
+  }
+
+  if (iss >> castling && castling != "-")
+    for (char c : castling) {
+      Color color = islower(c) ? BLACK : WHITE;
+      char f = char(tolower(c));
+
+      if (!((f >= 'a' && f <= 'h') || f == 'k' || f == 'q')) {
+        error = std::string("unexpected castling right '") + c + "'";
+        return false;
+      }
+
+      if (!backRook[color]) {
+        error = std::string("castling right '") + c + "' without a rook";
+        return false;
+      }
+    }
+
+  if (iss >> enpassant && enpassant != "-" &&
+      (enpassant.size() != 2 || enpassant[0] < 'a' || enpassant[0] > 'h' ||
+       (enpassant[1] != '3' && enpassant[1] != '6'))) {
+    error = "invalid en passant square '" + enpassant + "'";
+    return false;
+  }
+
+  return true;
+}
+
+// Whether the query [line] is well formed: its FEN must be valid (see
+// is_valid_fen()) and its budget options must be followed by a non-negative
+// integer. Otherwise, [error] tells what is wrong. Malformed FENs must not
+// reach Position::set(), which assumes they are correct.
+
+bool QUERY::check_line(const std::string& line, std::string& error) {
+  std::string fen, token, value;
+  std::istringstream iss(line);
+
+  while (iss >> token && !ends_fen(token)) fen += token + " ";
+
+  if (!is_valid_fen(fen, error)) return false;
+
+  do {
+    if (token == "#") break;
+
+    if (is_budget_option(token) && !(iss >> value && is_number(value))) {
+      error = "option " + token + " expects a non-negative integer";
+      return false;
+    }
+  } while (iss >> token);
+
+  return true;
+}
+
+// We expect input commands to be a line of text containing a FEN followed by
+// the intended winner ('white' or 'black') or nothing (the default intended
+// winner is the last player who moved). Options given in the line are applied
+// on [settings]. Everything after a '#' is a comment. The position is set on
+// the Stockfish thread [th].
+
+Color QUERY::parse_line(Position& pos, StateInfo* si, Thread* th,
+                        const std::string& line, Settings& settings) {
+  std::string fen, token;
+  std::istringstream iss(line);
+  Color winner = COLOR_NB;
+
+  while (iss >> token && !ends_fen(token)) fen += token + " ";
+
+  pos.set(fen, false, si, th);
+
+  do {
+    if (token == "#")
+      break;
+
+    else if (token == "white")
+      winner = WHITE;
+
+    else if (token == "black")
+      winner = BLACK;
+
+    else if (token == "-full")
+      settings.mode = FULL;
+
+    else if (token == "-quick")
+      settings.mode = QUICK;
+
+    else if (token == "-min")
+      settings.mode = SHORTEST;
+
+    else if (token == "-tiered")
+      settings.mode = TIERED;
+
+    else if (token == "-dead")
+      settings.mode = DEAD;
+
+    else if (token == "-phases")
+      settings.reportPhases = true;
+
+    else if (token == "-limit")
+      read_budget(iss, settings.globalLimit, settings.capBudgets, false);
+
+    else if (token == "-deadline")
+      read_budget(iss, settings.timeLimit, settings.capBudgets, true);
+
+    else if (token == "-quick-deadline")
+      read_budget(iss, settings.quickTimeLimit, settings.capBudgets, true);
+
+    else if (token == "-deep-limit")
+      read_budget(iss, settings.deepLimit, settings.capBudgets, false);
+
+    else if (token == "-deep-deadline")
+      read_budget(iss, settings.deepTimeLimit, settings.capBudgets, true);
+
+  } while (iss >> token);
+
+  return winner == COLOR_NB ? ~pos.side_to_move() : winner;
+}
+
+namespace {
+
+const char* TierNames[] = {"", "quick", "full", "deep"};
+
+// Analyze the query in [line] in TIERED mode, [tier] is set to the tier that
+// decided the result and [nodes] to the nodes of all the tiers that were run
+// (every tier starts counting again)
+
+DYNAMIC::SearchResult tiered_analysis(QUERY::Context& ctx,
+                                      const std::string& line,
+                                      QUERY::Settings& settings,
+                                      QUERY::Tier& tier, uint64_t& nodes) {
+  DYNAMIC::Search& search = ctx.search;
+  DYNAMIC::SearchResult result;
+
+  tier = QUERY::QUICK_TIER;
+  search.set_time_limit(settings.quickTimeLimit);
+  result = DYNAMIC::quick_analysis(ctx.pos, search, false);
+  nodes = search.get_nb_nodes();
+
+  if (result == DYNAMIC::UNWINNABLE) return result;
+
+  // The quick analysis may have moved pieces, start again from the query
+  tier = QUERY::FULL_TIER;
+  QUERY::parse_line(ctx.pos, &ctx.rootState, &ctx.thread, line, settings);
+  search.set_limit(settings.globalLimit);
+  search.set_time_limit(settings.timeLimit);
+  result = DYNAMIC::full_analysis(ctx.pos, search);
+  nodes += search.get_nb_nodes();
+
+  if (result != DYNAMIC::UNDETERMINED) return result;
+
+  tier = QUERY::DEEP_TIER;
+  QUERY::parse_line(ctx.pos, &ctx.rootState, &ctx.thread, line, settings);
+  search.set_limit(settings.deepLimit);
+  search.set_time_limit(settings.deepTimeLimit);
+  result = DYNAMIC::full_analysis(ctx.pos, search);
+  nodes += search.get_nb_nodes();
+
+  return result;
+}
+
+// Analyze the query in DEAD mode, the search of Black shares the budgets and
+// the cancellation of the search of White
+
+DYNAMIC::SearchResult dead_analysis(QUERY::Context& ctx,
+                                    const QUERY::Settings& settings) {
+  DYNAMIC::Search& black = ctx.blackSearch;
+  DYNAMIC::SearchResult result;
+
+  black.set_limit(settings.globalLimit);
+  black.set_time_limit(settings.timeLimit);
+  black.set_cancel_flag(ctx.search.cancel_flag());
+  black.set_profiling(settings.profiling || settings.reportPhases);
+  black.set_perf_counters(settings.perfCounters);
+  black.reset_stats();
+
+  result = DYNAMIC::dead_analysis(ctx.pos, ctx.search, black);
+  black.set_cancel_flag(nullptr);
+
+  return result == DYNAMIC::UNDETERMINED && ctx.search.is_cancelled()
+             ? DYNAMIC::CANCELLED
+             : result;
+}
+
+// In DEAD mode, the verdict is printed like the result of a search, with the
+// nodes of both searches
+
+void print_dead_result(std::ostream& os, DYNAMIC::SearchResult result,
+                       uint64_t nodes) {
+  os << (result == DYNAMIC::WINNABLE     ? "winnable"
+         : result == DYNAMIC::UNWINNABLE ? "unwinnable"
+         : result == DYNAMIC::CANCELLED  ? "cancelled"
+                                         : "undetermined")
+     << " nodes " << nodes;
+}
+
+}  // namespace
+
+// QUERY::analyze() answers the query given in [line].
+
+void QUERY::analyze(Context& ctx, const std::string& line,
+                    const Settings& runSettings, Answer& answer) {
+  Position& pos = ctx.pos;
+  DYNAMIC::Search& search = ctx.search;
+  DYNAMIC::SearchResult result;
+  Settings settings = runSettings;
+  std::string error;
+
+  // Malformed queries are answered with an error and not analyzed
+  answer.valid = check_line(line, error);
+  if (!answer.valid) {
+    answer.result = DYNAMIC::UNDETERMINED;
+    answer.tier = NO_TIER;
+    answer.nodes = 0;
+    answer.duration = 0;
+    answer.profiled = false;
+    answer.output = "error: " + error + " (" + line + ")";
+    answer.slowEntry.clear();
+    answer.trace.clear();
+    return;
+  }
+
+  Color winner = parse_line(pos, &ctx.rootState, &ctx.thread, line, settings);
+  bool logSlow = settings.slowTime || settings.slowNodes;
+
+  // The analysis may modify the position (trivial progress)
+  std::string fen = logSlow ? pos.fen() : "";
+
+  search.set_winner(winner);
+  search.set_limit(settings.globalLimit);
+  search.set_time_limit(settings.timeLimit);
+  search.set_profiling(settings.profiling || settings.reportPhases);
+  search.set_perf_counters(settings.perfCounters);
+  search.set_tracer(settings.tracing ? &ctx.tracer : nullptr);
+  if (settings.tracing) ctx.tracer.reset(settings.traceSample);
+  search.reset_stats();
+
+  Tier tier = NO_TIER;
+  uint64_t tieredNodes = 0;
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  if (settings.mode == TIERED)
+    result = tiered_analysis(ctx, line, settings, tier, tieredNodes);
+
+  else if (settings.mode == SHORTEST)
+    result = DYNAMIC::find_shortest(pos, search);
+
+  else if (settings.mode == QUICK)
+    result = DYNAMIC::quick_analysis(pos, search, false);
+
+  else if (settings.mode == DEAD)
+    result = dead_analysis(ctx, settings);
+
+  else
+    result = DYNAMIC::full_analysis(pos, search);
+
+  auto stop = std::chrono::high_resolution_clock::now();
+  auto diff =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
+
+  answer.result = result;
+  answer.tier = tier;
+  answer.nodes = tier != NO_TIER ? tieredNodes : search.get_nb_nodes();
+  answer.profiled = settings.profiling || settings.reportPhases;
+  for (int p = 0; p < DYNAMIC::PHASE_NB; ++p)
+    answer.phases[p] = search.get_phase_stats(DYNAMIC::Phase(p));
+  answer.duration = diff.count();
+  answer.output.clear();
+
+  if (settings.mode == DEAD) {
+    answer.nodes += ctx.blackSearch.get_nb_nodes();
+
+    for (int p = 0; p < DYNAMIC::PHASE_NB; ++p) {
+      DYNAMIC::PhaseStats& stats = answer.phases[p];
+      const DYNAMIC::PhaseStats& black =
+          ctx.blackSearch.get_phase_stats(DYNAMIC::Phase(p));
+
+      stats.calls += black.calls;
+      stats.time += black.time;
+      stats.nodes += black.nodes;
+      stats.saturations += black.saturations;
+      stats.rounds += black.rounds;
+      stats.ttHits += black.ttHits;
+      for (int e = 0; e < PERF::EVENT_NB; ++e)
+        stats.counters[e] += black.counters[e];
+    }
+  }
+
+  auto print_result = [&](std::ostream& out) {
+    if (settings.mode == DEAD)
+      print_dead_result(out, result, answer.nodes);
+    else
+      search.print_result(out);
+  };
+
+  std::ostringstream os;
+
+  // The phases are those of answer.phases (both searches in DEAD mode),
+  // with the hardware counters if they are available
+  bool counters = settings.perfCounters && PERF::thread_group();
+
+  // A dead position is a draw, otherwise the result of a timeout depends on
+  // the player who ran out of time, which is not given in DEAD mode
+  if (settings.adjudicateTimeout) {
+    if (result == DYNAMIC::UNWINNABLE)
+      os << "1/2-1/2";
+
+    else if (settings.mode == DEAD)
+      os << "*";
+
+    else if (winner == WHITE)
+      os << "1-0";
+
+    else
+      os << "0-1";
+  } else {
+    // On quick mode, we only print [unwinnable] ([undetermined] are all
+    // guessed to be [winnable]).
+    // On full mode, we print all cases except possibly [winnable].
+    if (settings.reportAll ||
+        ((settings.mode != QUICK || result == DYNAMIC::UNWINNABLE) &&
+         (!settings.skipWinnable || result != DYNAMIC::WINNABLE))) {
+      print_result(os);
+      if (tier != NO_TIER) os << " tier " << TierNames[tier];
+      if (settings.reportPhases)
+        DYNAMIC::print_phases(os, answer.phases, counters);
+      os << " time " << answer.duration / 1000 << " (" << line << ")";
+    }
+  }
+
+  answer.output = os.str();
+  answer.slowEntry.clear();
+  answer.trace.clear();
+
+  if (settings.tracing && result == DYNAMIC::UNDETERMINED)
+    ctx.tracer.events(answer.trace);
+
+  if (logSlow && ((settings.slowTime &&
+                   answer.duration >= settings.slowTime * 1000) ||
+                  (settings.slowNodes && answer.nodes >= settings.slowNodes))) {
+    std::ostringstream entry;
+    entry << fen
+          << (settings.mode == DEAD     ? " -dead"
+              : winner == WHITE ? " white"
+                                : " black")
+          << " # ";
+    print_result(entry);
+    if (tier != NO_TIER) entry << " tier " << TierNames[tier];
+    entry << " time " << answer.duration / 1000;
+    DYNAMIC::print_phases(entry, answer.phases, counters);
+    answer.slowEntry = entry.str();
+  }
+}
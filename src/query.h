@@ -0,0 +1,135 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#ifndef QUERY_H_INCLUDED
+#define QUERY_H_INCLUDED
+
+// A query is a line of text containing a FEN followed by the intended winner
+// ('white' or 'black') or nothing (the default intended winner is the last
+// player who moved). A query may also carry options that override the settings
+// of the run for that query only: '-full', '-quick', '-min', '-tiered',
+// '-dead', '-phases', '-limit N' and '-deadline N' (in microseconds), as well
+// as the budgets of the tiered mode (see below).
+// This file is in charge of answering queries, it is shared by all the
+// front-ends of the tool (the sequential loop, the pipeline and the server).
+
+namespace QUERY {
+
+enum Mode { FULL, QUICK, SHORTEST, TIERED, DEAD };
+
+// In DEAD mode, the intended winner is ignored: both players are analyzed in
+// one pass (see DYNAMIC::dead_analysis) and the position is unwinnable if no
+// player can win (it is dead).
+
+// In TIERED mode, positions go through a quick analysis first. Only if that
+// does not prove them unwinnable they go through a full analysis and only if
+// the full analysis is undetermined they go through a deep analysis (a full
+// analysis with much larger budgets). The tier that decided is reported.
+
+enum Tier { NO_TIER, QUICK_TIER, FULL_TIER, DEEP_TIER };
+
+// Settings that apply to all the queries of a run
+
+struct Settings {
+  Mode mode = FULL;
+  bool skipWinnable = false;
+  bool adjudicateTimeout = false;
+  bool reportAll = false;  // Report every answer, even if quick or winnable
+  bool reportPhases = false;  // Report per-phase statistics with every answer
+  bool profiling = false;     // Measure the time of every phase
+  bool perfCounters = false;  // Count hardware events in every phase
+  uint64_t globalLimit = 500000;
+  uint64_t timeLimit = 0;  // In microseconds, 0 means no limit
+
+  // Budgets of the quick and deep tiers (the full tier takes the above)
+  uint64_t quickTimeLimit = 0;
+  uint64_t deepLimit = 10000000;
+  uint64_t deepTimeLimit = 0;
+
+  // Whether the budgets given in a query are capped by the above ones, so that
+  // clients of the server cannot ask for more work than the server allows
+  bool capBudgets = false;
+
+  // Thresholds of the slow-query log (0 means no threshold): queries taking
+  // longer (in microseconds) or more nodes are recorded in Answer::slowEntry
+  uint64_t slowTime = 0;
+  uint64_t slowNodes = 0;
+
+  // Trace the search of find_mate (one node out of every traceSample) and
+  // report the trace of undetermined queries in Answer::trace
+  bool tracing = false;
+  uint64_t traceSample = 64;
+};
+
+// A Context stores everything needed to answer queries. Contexts are not
+// thread-safe, every thread answering queries must have its own Context.
+
+struct Context {
+  // The Stockfish thread of the position, whose node counter is increased by
+  // every move: a thread per Context, so that analyzers do not contend on it
+  Thread thread;
+  Position pos;
+  StateInfo rootState;
+  DYNAMIC::Search search;
+  TranspositionTable tt;
+  TRACE::Tracer tracer;
+
+  // The search of Black in DEAD mode. The searches are interleaved, so it
+  // needs its own table (only allocated if it is used).
+  DYNAMIC::Search blackSearch;
+  TranspositionTable blackTT;
+
+  // The tables are only resized when the "Hash" option changes
+  size_t hashSize = 0;
+
+  Context();
+  void init(const Settings& settings);
+};
+
+// The answer to a query: the result of the analysis, the time it took (in
+// nanoseconds), the statistics of the search and the text to be reported
+// (possibly empty). Slow queries also get an entry for the slow-query log: a
+// query that reproduces them (FEN and intended winner), followed by a comment
+// with the verdict, the nodes, the time and the phase breakdown. Malformed
+// queries are not analyzed, they are answered with an error line only.
+
+struct Answer {
+  bool valid;
+  DYNAMIC::SearchResult result;
+  Tier tier;
+  uint64_t duration;
+  uint64_t nodes;
+  bool profiled;
+  DYNAMIC::PhaseStats phases[DYNAMIC::PHASE_NB];
+  std::string output;
+  std::string slowEntry;
+  std::vector<TRACE::Event> trace;
+};
+
+bool is_valid_fen(const std::string& fen, std::string& error);
+
+bool check_line(const std::string& line, std::string& error);
+
+Color parse_line(Position& pos, StateInfo* si, Thread* th,
+                 const std::string& line, Settings& settings);
+
+void analyze(Context& ctx, const std::string& line, const Settings& settings,
+             Answer& answer);
+
+}  // namespace QUERY
+
+#endif  // #ifndef QUERY_H_INCLUDED
@@ -19,293 +19,479 @@
 #include "util.h"
 #include "semistatic.h"
 
-void SemiStatic::System::init() {
-  int i, j;
-  Square presquares[8];
-
-  for (PieceType p = PAWN; p <= KING; ++p)
-    for (Color c : {WHITE, BLACK})
-      for (Square s = SQ_A1; s <= SQ_H8; ++s)
-        for (Square t = SQ_A1; t <= SQ_H8; ++t) {
-          i = index(p, c, s, t);
-          UTIL::unmove(presquares, p, c, t);
-
-          for (j = 0; j < 8; ++j) {
-            if (presquares[j] < 0)
-              equations[i][j] = -1;
-            else
-              equations[i][j] = index(p, c, s, presquares[j]);
-          }
-        }
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+// Instrumentation counters (one per thread, like the System)
+
+static thread_local SemiStatic::Counters COUNTERS;
+
+const SemiStatic::Counters& SemiStatic::counters() { return COUNTERS; }
+
+SemiStatic::Placement::Placement(const Position& pos) {
+  std::fill(board, board + SQUARE_NB, NO_PIECE);
+  for (Bitboard b = pos.pieces(); b;) {
+    Square s = pop_lsb(b);
+    board[s] = pos.piece_on(s);
+  }
+
+  for (PieceType pt = ALL_PIECES; pt <= KING; ++pt) byType[pt] = pos.pieces(pt);
+  byColor[WHITE] = pos.pieces(WHITE);
+  byColor[BLACK] = pos.pieces(BLACK);
 }
 
-void SemiStatic::System::saturate(Position& pos) {
-  // Initialize the variables
+// As Position::attackers_to
 
-  for (int j = 0; j < N_MOVE_VARS; ++j) variables[j] = false;
+Bitboard SemiStatic::Placement::attackers_to(Square s) const {
+  Bitboard occupied = pieces();
 
-  for (int j = 0; j < 4 * 128; ++j) variables[N_MOVE_VARS + j] = false;
+  return (pawn_attacks_bb(BLACK, s) & pieces(WHITE, PAWN)) |
+         (pawn_attacks_bb(WHITE, s) & pieces(BLACK, PAWN)) |
+         (attacks_bb<KNIGHT>(s) & pieces(KNIGHT)) |
+         (attacks_bb<ROOK>(s, occupied) & (pieces(ROOK) | pieces(QUEEN))) |
+         (attacks_bb<BISHOP>(s, occupied) & (pieces(BISHOP) | pieces(QUEEN))) |
+         (attacks_bb<KING>(s) & pieces(KING));
+}
 
-  // The following four variables are part of our logic for capturing
-  // stalemate motifs
-  int whiteMovements = 0;
-  int blackMovements = 0;
-  Square whiteExtraKingSquare = UTIL::find_king(pos, WHITE);
-  Square blackExtraKingSquare = UTIL::find_king(pos, BLACK);
+namespace {
 
-  Square occupied[64];
-  int n = 0;
+// The squares of the file of [s] after [s], up to [t] (included)
 
-  for (Square s = SQ_A1; s <= SQ_H8; ++s) {
-    Piece pc = pos.piece_on(s);
-    PieceType p = type_of(pc);
-    if (p == NO_PIECE_TYPE) {
-      variables[clear_index(WHITE, s)] = true;
-      variables[clear_index(BLACK, s)] = true;
-      continue;
+Bitboard file_span(Square s, Square t) {
+  Bitboard span = 0;
+  int step = t > s ? 8 : -8;
+
+  for (int aux = t; aux != s; aux -= step) span |= Square(aux);
+
+  return span;
+}
+
+// The squares above [s]
+
+inline Bitboard above(Square s) { return ~((square_bb(s) << 1) - 1); }
+
+// Frontier kernels. The successors of a square are at one of 16 offsets (one
+// step in each direction and the knight jumps), masked to discard the shifts
+// that wrap around the board. Every piece (type and color) follows a subset
+// of the offsets, as in UTIL::PREDECESSORS.
+
+constexpr int OFFSETS[16] = {1, -1, 7, -7, 8, -8, 9, -9,
+                             6, -6, 10, -10, 15, -15, 17, -17};
+
+constexpr Bitboard NOT_A = ~FileABB;
+constexpr Bitboard NOT_H = ~FileHBB;
+constexpr Bitboard NOT_AB = ~(FileABB | FileBBB);
+constexpr Bitboard NOT_GH = ~(FileGBB | FileHBB);
+
+constexpr Bitboard OFFSET_MASKS[16] = {
+    NOT_A,  NOT_H,  NOT_H,  NOT_A, AllSquares, AllSquares, NOT_A, NOT_H,
+    NOT_GH, NOT_AB, NOT_AB, NOT_GH, NOT_H,     NOT_A,      NOT_A, NOT_H};
+
+constexpr uint16_t ORTHOGONAL = 0x33;
+constexpr uint16_t DIAGONAL = 0xCC;
+constexpr uint16_t ONE_STEP = ORTHOGONAL | DIAGONAL;
+constexpr uint16_t JUMPS = 0xFF00;
+
+// Indexed by piece type and color
+constexpr uint16_t DIRECTIONS[PIECE_TYPE_NB][COLOR_NB] = {
+    {0, 0},
+    {0x54, 0xA8},  // Pawns (pushes and captures, forward)
+    {JUMPS, JUMPS},
+    {DIAGONAL, DIAGONAL},
+    {ORTHOGONAL, ORTHOGONAL},
+    {ONE_STEP, ONE_STEP},
+    {ONE_STEP, ONE_STEP}};
+
+#ifdef AVX2_KERNEL
+
+// Padding lanes (NO_PIECE) have no directions, so their frontier stays empty
+
+inline uint16_t directions(Piece pc) {
+  return pc == NO_PIECE ? 0 : DIRECTIONS[type_of(pc)][color_of(pc)];
+}
+
+// Computes the frontiers of [n] pieces (a multiple of 4), 4 at a time
+
+__attribute__((target("avx2"))) void expand_avx2(const Bitboard* rows,
+                                                 const Piece* pieces,
+                                                 Bitboard* frontiers, int n) {
+  for (int i = 0; i < n; i += 4) {
+    __m256i r = _mm256_loadu_si256((const __m256i*)(rows + i));
+    __m256i dirs = _mm256_set_epi64x(
+        directions(pieces[i + 3]), directions(pieces[i + 2]),
+        directions(pieces[i + 1]), directions(pieces[i]));
+    __m256i f = _mm256_setzero_si256();
+
+    for (int k = 0; k < 16; ++k) {
+      __m256i bit = _mm256_set1_epi64x(1LL << k);
+      __m256i enabled = _mm256_cmpeq_epi64(_mm256_and_si256(dirs, bit), bit);
+      __m256i shifted =
+          OFFSETS[k] > 0
+              ? _mm256_sll_epi64(r, _mm_cvtsi32_si128(OFFSETS[k]))
+              : _mm256_srl_epi64(r, _mm_cvtsi32_si128(-OFFSETS[k]));
+
+      shifted = _mm256_and_si256(
+          shifted, _mm256_set1_epi64x(int64_t(OFFSET_MASKS[k])));
+      f = _mm256_or_si256(f, _mm256_and_si256(shifted, enabled));
     }
 
-    Color c = color_of(pc);
-    variables[clear_index(~c, s)] = true;
+    _mm256_storeu_si256((__m256i*)(frontiers + i), f);
+  }
+}
+
+#endif
+
+// Computes the frontiers of the pieces of [n] lanes (a multiple of 4, padded
+// with empty rows of NO_PIECE)
 
-    variables[index(p, c, s, s)] = true;
-    occupied[n] = s;
-    n++;
+void expand_lanes(SemiStatic::Kernel kernel, const Bitboard* rows,
+                  const Piece* pieces, Bitboard* frontiers, int n) {
+#ifdef AVX2_KERNEL
+  if (kernel == SemiStatic::AVX2) {
+    expand_avx2(rows, pieces, frontiers, n);
+    return;
   }
+#endif
 
-  // Saturate the system
+  for (int i = 0; i < n; ++i) {
+    frontiers[i] = 0;
+    if (pieces[i] == NO_PIECE) continue;
 
-  bool change = true;
-  int round = 0;
+    const Bitboard* successors =
+        UTIL::PREDECESSORS
+            .successors[type_of(pieces[i]) - 1][color_of(pieces[i])];
 
-  while (change) {
-    change = false;
-    round++;
-
-    for (int k = 0; k < n; ++k) {
-      Square source = occupied[k];
-      Piece pc = pos.piece_on(source);
-      PieceType p = type_of(pc);
-      Color c = color_of(pc);
-
-      // Update Clear variables: a piece can be cleared from a squared if it can
-      // move or it can be captured in that square)
-
-      for (Square aux = SQ_A1; aux <= SQ_H8; ++aux) {
-        PieceType aux_piece = type_of(pos.piece_on(aux));
-        if (source == aux) continue;
-
-        if (variables[index(p, c, source, aux)] ||
-            (aux_piece != NO_PIECE_TYPE &&
-             variables[index(aux_piece, ~c, aux, source)]))
-          if (!variables[clear_index(c, source)]) {
-            change = true;
-            variables[clear_index(c, source)] = true;
-            break;
-          }
+    for (Bitboard r = rows[i]; r;) frontiers[i] |= successors[pop_lsb(r)];
+  }
+}
+
+inline int padded(int n) { return (n + 3) & ~3; }
+
+}  // namespace
+
+SemiStatic::Kernel SemiStatic::best_kernel() {
+#ifdef AVX2_KERNEL
+  static const Kernel best = __builtin_cpu_supports("avx2") ? AVX2 : SCALAR;
+  return best;
+#else
+  return SCALAR;
+#endif
+}
+
+const char* SemiStatic::kernel_name(Kernel kernel) {
+  return kernel == AVX2 ? "avx2" : "scalar";
+}
+
+// Kernels that the CPU does not support fall back to the scalar one
+
+void SemiStatic::System::set_kernel(Kernel k) {
+  kernel = k == AVX2 && best_kernel() != AVX2 ? SCALAR : k;
+}
+
+bool SemiStatic::System::same_variables(const System& other) const {
+  return std::equal(reach, reach + SQUARE_NB, other.reach) &&
+         std::equal(clear, clear + COLOR_NB, other.clear) &&
+         std::equal(reachable, reachable + COLOR_NB, other.reachable) &&
+         std::equal(capture, capture + COLOR_NB, other.capture);
+}
+
+// Collects the lanes of the frontier kernels: the occupied squares, with the
+// reach of their pieces. Returns the number of lanes.
+
+int SemiStatic::System::lanes(const Placement& pos, Square* sources,
+                              Bitboard* rows, Piece* pieces) const {
+  int n = 0;
+
+  for (Bitboard b = pos.pieces(); b; ++n) {
+    sources[n] = pop_lsb(b);
+    rows[n] = reach[sources[n]];
+    pieces[n] = pos.piece_on(sources[n]);
+  }
+
+  return n;
+}
+
+// Computes the frontier of the piece on every occupied square: the squares
+// that it would reach with one more move from the squares in its reach
+
+void SemiStatic::System::expand(const Placement& pos,
+                                Bitboard frontiers[SQUARE_NB]) {
+  Square sources[SQUARE_NB];
+  Bitboard rows[SQUARE_NB], laneFrontiers[SQUARE_NB];
+  Piece pieces[SQUARE_NB];
+
+  int n = lanes(pos, sources, rows, pieces);
+  if (!n) return;  // Nothing to expand (and no lane for the kernels)
+
+  for (int i = n; i < padded(n); ++i) {
+    rows[i] = 0;
+    pieces[i] = NO_PIECE;
+  }
+
+  expand_lanes(kernel, rows, pieces, laneFrontiers, padded(n));
+
+  for (int i = 0; i < n; ++i) frontiers[sources[i]] = laneFrontiers[i];
+}
+
+void SemiStatic::System::start(const Placement& pos) {
+  // Initialize the variables
+
+  std::fill(reach, reach + SQUARE_NB, 0);
+  for (Bitboard b = pos.pieces(); b;) {
+    Square s = pop_lsb(b);
+    reach[s] = square_bb(s);
+  }
+
+  clear[WHITE] = ~pos.pieces(WHITE);
+  clear[BLACK] = ~pos.pieces(BLACK);
+  reachable[WHITE] = reachable[BLACK] = 0;
+  capture[WHITE] = capture[BLACK] = 0;
+
+  round = 0;
+  movements[WHITE] = movements[BLACK] = 0;
+  extraKingSquare[WHITE] = pos.king(WHITE);
+  extraKingSquare[BLACK] = pos.king(BLACK);
+
+  COUNTERS.saturations++;
+}
+
+// Performs a round of the saturation, returns false if nothing changed. The
+// reach of every piece only changes on its own turn of the round, so all the
+// frontiers can be computed at once beforehand.
+
+bool SemiStatic::System::step(const Placement& pos,
+                              const Bitboard frontiers[SQUARE_NB]) {
+  bool change = false;
+  round++;
+  COUNTERS.rounds++;
+
+  for (Bitboard b = pos.pieces(); b;) {
+    Square source = pop_lsb(b);
+    Piece pc = pos.piece_on(source);
+    PieceType p = type_of(pc);
+    Color c = color_of(pc);
+
+    // Update Clear variables: a piece can be cleared from a squared if it can
+    // move or it can be captured in that square)
+
+    if (!(clear[c] & source)) {
+      bool cleared = reach[source] & ~square_bb(source);
+      Bitboard capturers = pos.pieces(~c);
+
+      while (capturers && !cleared)
+        cleared = reach[pop_lsb(capturers)] & source;
+
+      if (cleared) {
+        change = true;
+        clear[c] |= source;
       }
+    }
 
-      // Update Reach and Capture variable:
-      // Reach(c,s) is true if a non-king c-colored piece can reach square s
-      // Capture(c,s) is true if some c-colored piece could capture on s
-
-      for (Square target = SQ_A1; target <= SQ_H8; ++target)
-        if (variables[index(p, c, source, target)]) {
-          if (p != KING && !variables[reach_index(c, target)]) {
-            change = true;
-            variables[reach_index(c, target)] = true;
-          }
-
-          // We update pawn captures later
-          if (p != PAWN && !variables[capture_index(c, target)]) {
-            change = true;
-            variables[capture_index(c, target)] = true;
-          }
-        }
+    // Update Reach and Capture variable:
+    // Reach(c,s) is true if a non-king c-colored piece can reach square s
+    // Capture(c,s) is true if some c-colored piece could capture on s
+
+    if (p != KING && (reach[source] & ~reachable[c])) {
+      change = true;
+      reachable[c] |= reach[source];
+    }
+
+    // We update pawn captures later
+    if (p != PAWN && (reach[source] & ~capture[c])) {
+      change = true;
+      capture[c] |= reach[source];
+    }
+
+    // Update the Movement variables. Only the targets with a predecessor in
+    // reach[source] (the frontier) can change. They are visited in order,
+    // and every new target adds its successors above it to the frontier.
+
+    const int8_t(*predecessors)[8] = UTIL::PREDECESSORS.squares[p - 1][c];
+    const Bitboard* successors = UTIL::PREDECESSORS.successors[p - 1][c];
+
+    // Skip the targets that contain a piece of color c which cannot be
+    // cleared yet
+    Bitboard frontier = frontiers[source] & clear[c] & ~reach[source];
+
+    while (frontier) {
+      Square target = pop_lsb(frontier);
 
-      // Update the Movement variables
-
-      for (Square target = SQ_A1; target <= SQ_H8; ++target) {
-        // If the target square contains a piece of color c and cannot
-        // be cleared yet, continue
-        if (!variables[clear_index(c, target)]) continue;
-
-        // Check for KING attacks (if it moves to target)
-        if (p == KING) {
-          bool target_attacked = false;
-          Bitboard attackers = pos.attackers_to(target) & pos.pieces(~c);
-
-          for (int sq = 0; sq < 64; ++sq)
-            if ((attackers & (1ULL << sq)) &&
-                !variables[clear_index(~c, static_cast<Square>(sq))]) {
-              target_attacked = true;
-              break;
-            }
-          if (target_attacked) continue;
+      // Check for KING attacks (if it moves to target)
+      if (p == KING &&
+          (pos.attackers_to(target) & pos.pieces(~c) & ~clear[~c]))
+        continue;
+
+      for (int j = 0; j < 8 && predecessors[target][j] >= 0; ++j) {
+        if (!(reach[source] & Square(predecessors[target][j]))) continue;
+
+        // Update the Movement variable
+
+        if (p == PAWN) {
+          // Pawn push cannot be performed if there is an obstacle in target
+          if (j == 0) {
+            if (!(clear[~c] & target)) continue;
+
+            // or if there is a pawn in target which could not leave its
+            // file and the source pawn could also not leave its file
+
+            Piece tpiece = pos.piece_on(target);
+
+            if (type_of(tpiece) == PAWN && color_of(tpiece) != c &&
+                file_of(source) == file_of(target) &&
+                !((reach[source] | reach[target]) & ~file_bb(source)) &&
+                !(capture[c] & file_span(source, target)))
+              continue;
+
+          }  // end push
+
+          // Pawn capture cannot be performed
+          if (j > 0 && !(reachable[~c] & target)) continue;
+
+          if (j > 0) capture[c] |= target;
         }
 
-        int i = index(p, c, source, target);
-
-        for (int j = 0; j < 8; ++j) {
-          int var = equations[i][j];
-          if (var < 0 || variables[i]) break;
-
-          // Update the Movement variable
-
-          if (variables[var]) {
-            if (p == PAWN) {
-              // Pawn push cannot be performed if there is an obstacle in target
-              if (j == 0) {
-                if (!variables[clear_index(~c, target)]) continue;
-
-                // or if there is a pawn in target which could not leave its
-                // file and the source pawn could also not leave its file
-
-                Piece tpiece = pos.piece_on(target);
-
-                if (type_of(tpiece) == PAWN && color_of(tpiece) != c &&
-                    file_of(source) == file_of(target)) {
-                  bool confronting = true;
-                  for (Square aux = SQ_A1; aux <= SQ_H8; ++aux) {
-                    if (file_of(source) != file_of(aux)) {
-                      if (variables[index(p, c, source, aux)] ||
-                          variables[index(PAWN, ~c, target, aux)]) {
-                        confronting = false;
-                        break;
-                      }
-                    } else if ((rank_of(source) < rank_of(aux) &&
-                                rank_of(aux) <= rank_of(target)) ||
-                               (rank_of(source) > rank_of(aux) &&
-                                rank_of(aux) >= rank_of(target))) {
-                      if (variables[capture_index(c, aux)]) {
-                        confronting = false;
-                        break;
-                      }
-                    }
-                  }
-
-                  if (confronting) continue;
-                }
-
-              }  // end push
-
-              // Pawn capture cannot be performed
-              if (j > 0 && !variables[reach_index(~c, target)]) continue;
-
-              if (j > 0) variables[capture_index(c, target)] = true;
-            }
-
-            // --------- Logic to capture stalemate motifs ---------
-            if (c == WHITE) {
-              whiteMovements++;
-              if (p == KING) whiteExtraKingSquare = target;
-            } else {
-              blackMovements++;
-              if (p == KING) blackExtraKingSquare = target;
-            }
-
-            if (c == WHITE) {
-              if (p == KING && blackMovements <= 1) {
-                Square opp_king = UTIL::find_king(pos, ~c);
-                if (distance<Square>(target, opp_king) <= 1 ||
-                    distance<Square>(target, blackExtraKingSquare) <= 1)
-                  break;
-              }
-            } else {
-              if (p == KING && whiteMovements <= 1) {
-                Square opp_king = UTIL::find_king(pos, ~c);
-                if (distance<Square>(target, opp_king) <= 1 ||
-                    distance<Square>(target, whiteExtraKingSquare) <= 1)
-                  break;
-              }
-            }
-            // Do not allow captures in the first pass (this is to correctly
-            // load variables relative to [ExtraKingSquare]
-            if (round <= 1 && type_of(pos.piece_on(target)) != NO_PIECE_TYPE) {
-              change = true;
-              break;
-            }
-            // ------- End logic to capture stalemate motifs -------
-
-            change = true;
-            variables[i] = true;
+        // --------- Logic to capture stalemate motifs ---------
+        movements[c]++;
+        if (p == KING) extraKingSquare[c] = target;
 
+        if (p == KING && movements[~c] <= 1) {
+          Square opp_king = pos.king(~c);
+          if (distance<Square>(target, opp_king) <= 1 ||
+              distance<Square>(target, extraKingSquare[~c]) <= 1)
             break;
-          }
         }
-      }
+        // Do not allow captures in the first pass (this is to correctly
+        // load variables relative to [ExtraKingSquare]
+        if (round <= 1 && type_of(pos.piece_on(target)) != NO_PIECE_TYPE) {
+          change = true;
+          break;
+        }
+        // ------- End logic to capture stalemate motifs -------
 
-      // If the pawn can promote, it may go everywhere
-
-      if (p == PAWN) {
-        Square prom_rank = (c == WHITE) ? SQ_A8 : SQ_A1;
-        for (int file = 0; file < 8; ++file)
-          if (variables[index(p, c, source,
-                              static_cast<Square>(prom_rank + file))]) {
-            for (int j = 0; j < 64; ++j) {
-              int i = index(p, c, source, SQ_A1) + j;
-              change = variables[i] ? change : true;
-              variables[i] = true;
-            }
-            break;
-          }
+        change = true;
+        reach[source] |= target;
+        frontier |=
+            successors[target] & clear[c] & ~reach[source] & above(target);
+
+        break;
       }
     }
 
-  }  // end while
+    // If the pawn can promote, it may go everywhere
+
+    if (p == PAWN && (reach[source] & (c == WHITE ? Rank8BB : Rank1BB))) {
+      change = reach[source] != AllSquares ? true : change;
+      reach[source] = AllSquares;
+    }
+  }
+
+  return change;
+}
+
+// Returns false if the saturation was abandoned because [*cancel] was set
+
+bool SemiStatic::System::saturate(const Placement& pos,
+                                  const std::atomic<bool>* cancel) {
+  Bitboard frontiers[SQUARE_NB];
+  bool change = true;
+
+  start(pos);
+
+  while (change) {
+    if (cancel && cancel->load(std::memory_order_relaxed)) return false;
+
+    expand(pos, frontiers);
+    change = step(pos, frontiers);
+  }
+
+  return true;
 }
 
-Bitboard SemiStatic::System::king_region(Position& pos, Color c) {
-  Bitboard region = 0;
-  Square s = UTIL::find_king(pos, c);
-  for (Square t = SQ_A1; t <= SQ_H8; ++t)
-    if (variables[index(KING, c, s, t)]) region |= t;
+namespace {
 
-  return region;
+void get_placement(Position& pos, Bitboard placement[8]) {
+  placement[0] = pos.pieces(WHITE);
+  placement[1] = pos.pieces(BLACK);
+  for (PieceType p = PAWN; p <= KING; ++p) placement[p + 1] = pos.pieces(p);
 }
 
-// Returns the position of the pieces of color c that can visit the region
+}  // namespace
+
+// Returns false if the saturation was abandoned because [*cancel] was set (in
+// which case nothing is cached)
+
+bool SemiStatic::System::saturate_cached(Position& pos,
+                                         const std::atomic<bool>* cancel) {
+  Bitboard placement[8];
+  get_placement(pos, placement);
+
+  Key h = pos.pawn_key();
+  for (int i = 0; i < 8; ++i)
+    h ^= placement[i] * (0x9E3779B97F4A7C15ULL + 2 * i);
 
-Bitboard SemiStatic::System::visitors(Position& pos, Bitboard region, Color c,
-                                      bool expandedPawnRegion) {
+  if (!cache) cache.reset(new CacheEntry[CACHE_SIZE]());
+
+  CacheEntry& entry = cache[(h ^ (h >> 32)) & (CACHE_SIZE - 1)];
+
+  if (std::equal(placement, placement + 8, entry.placement)) {
+    std::copy(entry.reach, entry.reach + SQUARE_NB, reach);
+    std::copy(entry.clear, entry.clear + COLOR_NB, clear);
+    std::copy(entry.reachable, entry.reachable + COLOR_NB, reachable);
+    std::copy(entry.capture, entry.capture + COLOR_NB, capture);
+    return true;
+  }
+
+  if (!saturate(pos, cancel)) return false;
+
+  std::copy(placement, placement + 8, entry.placement);
+  std::copy(reach, reach + SQUARE_NB, entry.reach);
+  std::copy(clear, clear + COLOR_NB, entry.clear);
+  std::copy(reachable, reachable + COLOR_NB, entry.reachable);
+  std::copy(capture, capture + COLOR_NB, entry.capture);
+  return true;
+}
+
+Bitboard SemiStatic::System::king_region(const Placement& pos, Color c) {
+  return reach[pos.king(c)];
+}
+
+// Returns the position of the pieces of color c that can visit the region.
+// With [expandedPawnRegion], pawns also visit the region if they can reach a
+// square from which they would push or capture into it (from another file).
+
+Bitboard SemiStatic::System::visitors(const Placement& pos, Bitboard region,
+                                      Color c, bool expandedPawnRegion) {
   Bitboard visitors = 0;
   bool ignorePawns = popcount(king_region(pos, ~c)) > 1;
-  for (Square s = SQ_A1; s <= SQ_H8; ++s) {
-    Piece pc = pos.piece_on(s);
-    PieceType p = type_of(pc);
-
-    if (p == NO_PIECE_TYPE) continue;
-
-    // We ignore pawn visitors that are limited in movement (is this sound?)
-    if (p == PAWN && ignorePawns && !variables[index(p, c, s, SQ_A1)]) continue;
-
-    Color color = color_of(pc);
-    Square presquares[8];
-
-    for (Square t = SQ_A1; t <= SQ_H8; ++t)
-      if (color == c && (region & t)) {
-        if (variables[index(p, c, s, t)])
-          visitors |= s;
-
-        else if (p == PAWN && expandedPawnRegion && s % 8 != t % 8) {
-          // The squares from which a c-pawn attacks t
-          UTIL::unmove(presquares, p, c, t);
-          for (int j = 0; j < 8; ++j) {
-            if (presquares[j] < 0)
-              break;
-            if (variables[index(p, c, s, presquares[j])]) {
-              visitors |= s;
-              break;
-            }
-          }
-        }
+  Bitboard pieces = pos.pieces(c);
+
+  while (pieces) {
+    Square s = pop_lsb(pieces);
+    Bitboard targets = region;
+
+    if (type_of(pos.piece_on(s)) == PAWN) {
+      // We ignore pawn visitors that are limited in movement (is this sound?)
+      if (ignorePawns && !(reach[s] & SQ_A1)) continue;
+
+      if (expandedPawnRegion) {
+        Bitboard otherFiles = region & ~file_bb(s);
+        targets |= c == WHITE ? shift<SOUTH>(otherFiles) |
+                                    pawn_attacks_bb<BLACK>(otherFiles)
+                              : shift<NORTH>(otherFiles) |
+                                    pawn_attacks_bb<WHITE>(otherFiles);
       }
+    }
+
+    if (reach[s] & targets) visitors |= s;
   }
 
   return visitors;
 }
 
-bool SemiStatic::System::is_unwinnable(Position& pos, Color intendedWinner) {
+bool SemiStatic::System::is_unwinnable(const Placement& pos,
+                                       Color intendedWinner) {
   // if (UTIL::has_lonely_pawns(pos)) return false;
 
   Bitboard loserKingRegion = king_region(pos, ~intendedWinner);
@@ -326,35 +512,32 @@ bool SemiStatic::System::is_unwinnable(Position& pos, Color intendedWinner) {
 
   // All visitors are all of the same square color; if they are not all bishops,
   // declare the position as potentially winnable
-  for (Square s = SQ_A1; s <= SQ_H8; ++s)
-    if ((visitors & s) && type_of(pos.piece_on(s)) != BISHOP) return false;
+  if (visitors & ~pos.pieces(BISHOP)) return false;
 
   Bitboard visitorsSquareColor =
       (visitors & DarkSquares) ? DarkSquares : ~DarkSquares;
 
-  // For every candidate checkmating square s:
-  for (Square s = SQ_A1; s <= SQ_H8; ++s) {
-    // Check that at least a visitor can go to s and s is in the mating region
+  // For every candidate checkmating square s in the mating region:
+  Bitboard candidates = loserKingRegion;
+  while (candidates) {
+    Square s = pop_lsb(candidates);
+
+    // Check that at least a visitor can go to s
     Bitboard matingBishops =
         SemiStatic::System::visitors(pos, square_bb(s), intendedWinner, false) &
         ~pos.pieces(intendedWinner, KING);
 
-    if (!matingBishops || !(loserKingRegion & s)) continue;
+    if (!matingBishops) continue;
 
-    Bitboard escapingSquares = 0;
-    Bitboard checkingSquares = 0;
-    for (Square t = SQ_A1; t <= SQ_H8; ++t)
-      if (distance<Square>(s, t) == 1 && (loserKingRegion & t)) {
-        if (~visitorsSquareColor & t)
-          escapingSquares |= t;
-        else
-          checkingSquares |= t;
-      }
+    Bitboard around = attacks_bb<KING>(s) & loserKingRegion;
+    Bitboard escapingSquares = around & ~visitorsSquareColor;
+    Bitboard checkingSquares = around & visitorsSquareColor;
 
     // Check if Winner's king can collaborate on the checkmate
     bool activeWinnersKing =
         pos.pieces(intendedWinner, KING) &
-        SemiStatic::System::visitors(pos, UTIL::neighbours(s), intendedWinner, false);
+        SemiStatic::System::visitors(pos, attacks_bb<KING>(s), intendedWinner,
+                                     false);
 
     // If there are two mating diagonals pointing to s, Winner must have at
     // least two bishops in the region (or their king); otherwise Loser's king
@@ -367,13 +550,13 @@ bool SemiStatic::System::is_unwinnable(Position& pos, Color intendedWinner) {
 
     // Check if some escaping square cannot be reached by the blockers
     bool unblockable = false;
-    for (Square e = SQ_A1; e <= SQ_H8; ++e)
-      if (escapingSquares & (1ULL << e))
-        if (!(~pos.pieces(KING) & SemiStatic::System::visitors(
-                 pos, square_bb(e), ~intendedWinner, false))) {
-          unblockable = true;
-          break;
-        }
+    Bitboard escapes = escapingSquares;
+    while (escapes && !unblockable) {
+      Bitboard e = square_bb(pop_lsb(escapes));
+      unblockable = !(~pos.pieces(KING) &
+                      SemiStatic::System::visitors(pos, e, ~intendedWinner,
+                                                   false));
+    }
 
     // The position is unwinnable if loser has not enough blockers for
     // the escaping squares
@@ -386,11 +569,7 @@ bool SemiStatic::System::is_unwinnable(Position& pos, Color intendedWinner) {
 
     // If there are as many blockers as escaping squares the position
     // may be winnable
-    int blockersCnt = activeWinnersKing ? 1 : 0;
-    for (Square blocker = SQ_A1; blocker <= SQ_H8; ++blocker)
-      if ((actualBlockers & blocker) &&
-          (SemiStatic::System::visitors(pos, escapingSquares, ~intendedWinner, false)))
-        blockersCnt++;
+    int blockersCnt = (activeWinnersKing ? 1 : 0) + popcount(actualBlockers);
 
     if (popcount(escapingSquares) <= blockersCnt) return false;
   }
@@ -402,43 +581,194 @@ bool SemiStatic::System::is_unwinnable(Position& pos, Color intendedWinner) {
   return true;
 }
 
-// Our global SemiStatic System variable.
+// A Batch keeps the storage of its positions from one use to the next
+
+void SemiStatic::Batch::clear() { count = 0; }
 
-static SemiStatic::System SYSTEM = SemiStatic::System();
+size_t SemiStatic::Batch::add(const Position& pos) {
+  if (count == placements.size()) {
+    placements.emplace_back();
+    systems.emplace_back();
+    active.push_back(false);
+  }
 
-// SemiStatic::init fills the equations relative to Movement variables
-// (must be executed only once).
+  placements[count] = Placement(pos);
+  return count++;
+}
 
-void SemiStatic::init() { SYSTEM.init(); }
+// Returns false if the saturation was abandoned because [*cancel] was set
 
-// Check if the position is semistatically unwinnable.
+bool SemiStatic::Batch::saturate(const std::atomic<bool>* cancel) {
+  size_t nbActive = count;
+
+  for (size_t i = 0; i < count; ++i) {
+    systems[i].start(placements[i]);
+    active[i] = true;
+  }
+
+  // Every position has at most SQUARE_NB lanes
+  sources.resize(count * SQUARE_NB + 3);
+  rows.resize(count * SQUARE_NB + 3);
+  pieces.resize(count * SQUARE_NB + 3);
+  frontiers.resize(count * SQUARE_NB + 3);
+
+  while (nbActive) {
+    if (cancel && cancel->load(std::memory_order_relaxed)) return false;
+
+    int n = 0;
+    for (size_t i = 0; i < count; ++i)
+      if (active[i])
+        n += systems[i].lanes(placements[i], &sources[n], &rows[n], &pieces[n]);
+
+    for (int i = n; i < padded(n); ++i) {
+      rows[i] = 0;
+      pieces[i] = NO_PIECE;
+    }
+
+    expand_lanes(kernel, rows.data(), pieces.data(), frontiers.data(),
+                 padded(n));
+
+    int lane = 0;
+    Bitboard positionFrontiers[SQUARE_NB];
+
+    for (size_t i = 0; i < count; ++i) {
+      if (!active[i]) continue;
+
+      for (int end = lane + popcount(placements[i].pieces()); lane < end;
+           ++lane)
+        positionFrontiers[sources[lane]] = frontiers[lane];
+
+      if (!systems[i].step(placements[i], positionFrontiers)) {
+        active[i] = false;
+        nbActive--;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool SemiStatic::Batch::is_unwinnable(size_t i, Color intendedWinner) {
+  return systems[i].is_unwinnable(placements[i], intendedWinner);
+}
+
+// Our SemiStatic System variable (one per thread, so that several positions
+// can be analyzed concurrently), and our Batch (for the children of a
+// position).
+
+static thread_local SemiStatic::System SYSTEM;
+static thread_local SemiStatic::Batch BATCH;
+
+bool SemiStatic::settle(Position& pos, Color intendedWinner, bool& unwinnable) {
+  MoveList<LEGAL> moveList(pos);
 
-bool SemiStatic::is_unwinnable(Position& pos, Color intendedWinner) {
   // Checkmate or Stalemate
-  if (MoveList<LEGAL>(pos).size() == 0)
-    return !pos.checkers() || pos.side_to_move() == intendedWinner;
+  if (moveList.size() == 0) {
+    unwinnable = !pos.checkers() || pos.side_to_move() == intendedWinner;
+    return true;
+  }
+
+  // If en passant is possible, the position is not unwinnable
+  for (const auto& m : moveList)
+    if (type_of(m) == ENPASSANT) {
+      unwinnable = false;
+      return true;
+    }
+
+  return false;
+}
+
+// Check if the position is semistatically unwinnable.
+
+bool SemiStatic::is_unwinnable(Position& pos, Color intendedWinner,
+                               const std::atomic<bool>* cancel) {
+  bool unwinnable;
+  if (settle(pos, intendedWinner, unwinnable)) return unwinnable;
 
-  // If en passant is possible, return false
-  for (const auto& m : MoveList<LEGAL>(pos))
-    if (type_of(m) == ENPASSANT) return false;
+  if (!SYSTEM.saturate_cached(pos, cancel)) return false;
 
-  SYSTEM.saturate(pos);
   return SYSTEM.is_unwinnable(pos, intendedWinner);
 }
 
-// Check if the position is unwinnable in all positions at depth 1 ply
+void SemiStatic::is_unwinnable_both(Position& pos, bool unwinnable[COLOR_NB],
+                                    const std::atomic<bool>* cancel) {
+  // Only checkmates depend on the intended winner
+  if (settle(pos, WHITE, unwinnable[WHITE])) {
+    settle(pos, BLACK, unwinnable[BLACK]);
+    return;
+  }
+
+  if (!SYSTEM.saturate_cached(pos, cancel)) {
+    unwinnable[WHITE] = unwinnable[BLACK] = false;
+    return;
+  }
+
+  Placement placement(pos);
+  for (Color c : {WHITE, BLACK})
+    unwinnable[c] = SYSTEM.is_unwinnable(placement, c);
+}
+
+// The cache is direct-mapped, indexed by the low bits of the key (the key of
+// the position with the intended winner mixed in). Verdicts of cancelled
+// analyses are not stored.
+
+namespace {
+
+constexpr int CACHE_SIZE = 4096;
+
+struct CacheEntry {
+  Key key;
+  bool unwinnable;
+};
+
+thread_local CacheEntry CACHE[CACHE_SIZE];
+
+}  // namespace
+
+bool SemiStatic::is_unwinnable_cached(Position& pos, Color intendedWinner,
+                                      const std::atomic<bool>* cancel) {
+  Key key = pos.key() ^ (intendedWinner == WHITE ? 0 : 0x9E3779B97F4A7C15ULL);
+  CacheEntry& entry = CACHE[key & (CACHE_SIZE - 1)];
+
+  if (entry.key == key) return entry.unwinnable;
+
+  bool unwinnable = is_unwinnable(pos, intendedWinner, cancel);
+
+  if (!cancel || !cancel->load(std::memory_order_relaxed)) {
+    entry.key = key;
+    entry.unwinnable = unwinnable;
+  }
+  return unwinnable;
+}
+
+// Check if the position is unwinnable in all positions at depth 1 ply. The
+// children that need a saturation are saturated together.
+
+bool SemiStatic::is_unwinnable_after_one_move(
+    Position& pos, Color intendedWinner, const std::atomic<bool>* cancel) {
+  MoveList<LEGAL> moveList(pos);
 
-bool SemiStatic::is_unwinnable_after_one_move(Position& pos,
-                                              Color intendedWinner) {
   // Checkmate or Stalemate
-  if (MoveList<LEGAL>(pos).size() == 0)
+  if (moveList.size() == 0)
     return !pos.checkers() || pos.side_to_move() == intendedWinner;
 
+  BATCH.clear();
+
   StateInfo st;
-  for (const auto& m : MoveList<LEGAL>(pos)) {
+  for (const auto& m : moveList) {
+    bool unwinnable = true;
+
     pos.do_move(m, st);
-    if (!is_unwinnable(pos, intendedWinner)) return false;
+    if (!settle(pos, intendedWinner, unwinnable)) BATCH.add(pos);
     pos.undo_move(m);
+
+    if (!unwinnable) return false;
   }
+
+  if (!BATCH.saturate(cancel)) return false;
+
+  for (size_t i = 0; i < BATCH.size(); ++i)
+    if (!BATCH.is_unwinnable(i, intendedWinner)) return false;
+
   return true;
 }
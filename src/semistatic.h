@@ -18,6 +18,9 @@
 #ifndef SEMISTATIC_H_INCLUDED
 #define SEMISTATIC_H_INCLUDED
 
+#include <memory>
+#include <vector>
+
 // This file is designed to determine which pieces can move in a given chess
 // position and the squares they can go to. The analysis is static in the sense
 // that it is performed based solely on the current position of the pieces.
@@ -38,66 +41,191 @@
 
 namespace SemiStatic {
 
-constexpr int N_MOVE_VARS = 49152;   // 2 * 6 * 64 * 64
-                                     // (color * piece_type * from_sq * to_sq)
-constexpr int N_PROM_VARS = 128;     // 2 * 64 (color * from_sq)
-constexpr int N_CLEAR_VARS = 128;    // 2 * 64 (color * square)
-constexpr int N_REACH_VARS = 128;    // 2 * 64 (color * square)
-constexpr int N_CAPTURE_VARS = 128;  // 2 * 64 (color * square)
+// Every round of the saturation starts by computing, for every piece, the
+// squares that are one move away from its reachable squares (the frontier).
+// The AVX2 kernel computes it for 4 pieces at once with shifts; the scalar
+// kernel reads the successors from UTIL::PREDECESSORS. Both give the same
+// result, the fastest one supported by the CPU is used by default.
+
+enum Kernel { SCALAR, AVX2 };
+
+Kernel best_kernel();
+const char* kernel_name(Kernel kernel);
+
+// The placement of the pieces of a position, which is all the saturation
+// reads from it. The analysis of a position can thus go on after its move
+// has been undone. Positions convert implicitly.
+
+class Placement {
+ public:
+  Placement() = default;
+  Placement(const Position& pos);
 
-// Equations for clear and reach variables are handeled independently:
+  Piece piece_on(Square s) const;
+  Bitboard pieces() const;
+  Bitboard pieces(Color c) const;
+  Bitboard pieces(PieceType pt) const;
+  Bitboard pieces(Color c, PieceType pt) const;
+  Bitboard attackers_to(Square s) const;
+  Square king(Color c) const;  // SQ_NONE if there is none
 
-constexpr int N_EQS = 49280;   // N_MOVE_VARS + N_PROM_VARS
-constexpr int N_VARS = 49664;  // N_MOVE_VARS + 128 * 4
+ private:
+  Piece board[SQUARE_NB];
+  Bitboard byType[PIECE_TYPE_NB];
+  Bitboard byColor[COLOR_NB];
+};
 
 class System {
  public:
   System() = default;
 
-  void init();
+  void set_kernel(Kernel k);
+  bool same_variables(const System& other) const;
 
-  int index(PieceType p, Color c, Square source, Square target) const;
-  void saturate(Position& pos);
-  Bitboard king_region(Position& pos, Color c);
-  Bitboard visitors(Position& pos, Bitboard region, Color c,
+  bool saturate(const Placement& pos,
+                const std::atomic<bool>* cancel = nullptr);
+  bool saturate_cached(Position& pos,
+                       const std::atomic<bool>* cancel = nullptr);
+  Bitboard king_region(const Placement& pos, Color c);
+  Bitboard visitors(const Placement& pos, Bitboard region, Color c,
                     bool expandedPawnRegion);
-  bool is_unwinnable(Position& pos, Color intendedWinner);
+  bool is_unwinnable(const Placement& pos, Color intendedWinner);
 
  private:
+  friend class Batch;
+
   // Data members
-  int equations[N_EQS][8];  // Each equation has at most 8 disjuncts.
-  bool variables[N_VARS];
+  // The equations do not depend on the position: X(s->t) depends on the
+  // variables X(s->u) for the (at most 8) predecessors u of t, read from
+  // UTIL::PREDECESSORS. The variables do depend on it, every thread must have
+  // its own System.
+  //
+  // The variables are stored as bitboards: X(s->t) is bit t of reach[s] (the
+  // piece of every X(s->t) is the one on s, so the source square alone
+  // identifies the row), and Clear(s,c), Reach(s,c) and Capture(s,c) are bit
+  // s of clear[c], reachable[c] and capture[c]. After a saturation, reach[s]
+  // holds the squares that the piece on s can reach (empty if there is none).
+  Bitboard reach[SQUARE_NB];
+  Bitboard clear[COLOR_NB];
+  Bitboard reachable[COLOR_NB];
+  Bitboard capture[COLOR_NB];
+
+  Kernel kernel = best_kernel();
+
+  // A saturation is a sequence of rounds: start() initializes the variables
+  // and every step() performs a round, given the frontiers of the pieces
+  // (computed by expand), until it reports no change. The state below is
+  // part of our logic for capturing stalemate motifs.
+  int round;
+  int movements[COLOR_NB];
+  Square extraKingSquare[COLOR_NB];
+
+  void start(const Placement& pos);
+  bool step(const Placement& pos, const Bitboard frontiers[SQUARE_NB]);
+  int lanes(const Placement& pos, Square* sources, Bitboard* rows,
+            Piece* pieces) const;
+  void expand(const Placement& pos, Bitboard frontiers[SQUARE_NB]);
+
+  // The saturation only depends on the placement of the pieces, so recent
+  // saturations (all the variables) are cached, indexed by a hash of the
+  // placement (the pawn key mixed with the piece bitboards) and verified on the
+  // full placement. The cache is only allocated by the first saturate_cached.
+  static constexpr int CACHE_SIZE = 128;
+
+  struct CacheEntry {
+    Bitboard placement[8];  // By color and by piece type
+    Bitboard reach[SQUARE_NB];
+    Bitboard clear[COLOR_NB];
+    Bitboard reachable[COLOR_NB];
+    Bitboard capture[COLOR_NB];
+  };
+
+  std::unique_ptr<CacheEntry[]> cache;
 };
 
-inline int System::index(PieceType p, Color c, Square source,
-                         Square target) const {
-  return (p - 1) * (1 << 13) +
-         ((c << 12) | (source << 6) | static_cast<int>(target));
-}
+// A Batch saturates several positions together, typically the children of a
+// position. Every position gets the same variables as with a System of its
+// own, but the rounds of all the positions run in lock-step, so that the
+// frontiers of the pieces of all of them are computed by one kernel call per
+// round (which keeps the vector lanes full).
 
-inline int color_square_index(Color c, Square s) { return (c << 6) | int(s); }
+class Batch {
+ public:
+  void clear();
+  size_t add(const Position& pos);
+  size_t size() const;
 
-inline int prom_index(Color c, Square s) {
-  return N_MOVE_VARS + color_square_index(c, s);
-}
+  bool saturate(const std::atomic<bool>* cancel = nullptr);
+  bool is_unwinnable(size_t i, Color intendedWinner);
+  const System& system(size_t i) const;
 
-inline int clear_index(Color c, Square s) {
-  return N_MOVE_VARS + N_PROM_VARS + color_square_index(c, s);
-}
+ private:
+  Kernel kernel = best_kernel();
+  size_t count = 0;  // Storage is kept (and reused) beyond count
+  std::vector<Placement> placements;
+  std::vector<System> systems;
+  std::vector<bool> active;  // Still changing
+
+  std::vector<Square> sources;
+  std::vector<Bitboard> rows;
+  std::vector<Piece> pieces;
+  std::vector<Bitboard> frontiers;
+};
+
+inline Piece Placement::piece_on(Square s) const { return board[s]; }
+
+inline Bitboard Placement::pieces() const { return byType[ALL_PIECES]; }
 
-inline int reach_index(Color c, Square s) {
-  return N_MOVE_VARS + N_PROM_VARS + N_CLEAR_VARS + color_square_index(c, s);
+inline Bitboard Placement::pieces(Color c) const { return byColor[c]; }
+
+inline Bitboard Placement::pieces(PieceType pt) const { return byType[pt]; }
+
+inline Bitboard Placement::pieces(Color c, PieceType pt) const {
+  return byColor[c] & byType[pt];
 }
 
-inline int capture_index(Color c, Square s) {
-  return N_MOVE_VARS + N_PROM_VARS + N_CLEAR_VARS + N_REACH_VARS +
-         color_square_index(c, s);
+inline Square Placement::king(Color c) const {
+  Bitboard king = pieces(c, KING);
+  return king ? lsb(king) : SQ_NONE;
 }
 
-void init();
+inline size_t Batch::size() const { return count; }
+
+// The variables of the [i]-th position, once saturated
+inline const System& Batch::system(size_t i) const { return systems[i]; }
+
+// Number of saturations performed (and their rounds) by the calling thread
+struct Counters {
+  uint64_t saturations;
+  uint64_t rounds;
+};
+
+const Counters& counters();
+
+// Decides the positions that is_unwinnable settles without a saturation
+// (checkmates, stalemates and positions with en passant captures), setting
+// [unwinnable]. Returns false if the position needs a saturation.
+
+bool settle(Position& pos, Color intendedWinner, bool& unwinnable);
+
+// Both functions give up (returning false) as soon as [*cancel] is set
+
+bool is_unwinnable(Position& pos, Color intendedWinner,
+                   const std::atomic<bool>* cancel = nullptr);
+bool is_unwinnable_after_one_move(Position& pos, Color intendedWinner,
+                                  const std::atomic<bool>* cancel = nullptr);
+
+// Same as is_unwinnable for both intended winners at once, with a single
+// saturation ([unwinnable] is indexed by intended winner)
+
+void is_unwinnable_both(Position& pos, bool unwinnable[COLOR_NB],
+                        const std::atomic<bool>* cancel = nullptr);
+
+// Same as is_unwinnable, but the verdicts are cached (per thread) by position
+// and intended winner, for the interior nodes of the dynamic search
 
-bool is_unwinnable(Position& pos, Color intendedWinner);
-bool is_unwinnable_after_one_move(Position& pos, Color intendedWinner);
+bool is_unwinnable_cached(Position& pos, Color intendedWinner,
+                          const std::atomic<bool>* cancel = nullptr);
 
 }  // namespace SemiStatic
 
@@ -0,0 +1,249 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#include "stockfish.h"
+#include "dynamic.h"
+#include "query.h"
+#include "pipeline.h"
+#include "server.h"
+#include <cerrno>
+#include <cstring>
+#include <list>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Connections beyond this number are refused (with an error line)
+const size_t MAX_CONNECTIONS = 64;
+
+// Connections sending a line longer than this (in bytes) are closed (with an
+// error line), so that a client cannot make the server buffer without bound
+const size_t MAX_LINE_LENGTH = 4096;
+
+// A connection is served by its own thread, which sets [finished] when done
+// and then writes a byte to [wakeup], so that the server joins the thread and
+// closes the socket right away (not at the next accept).
+
+struct Connection {
+  int fd;
+  int wakeup;
+  std::thread thread;
+  std::atomic<bool> finished;
+};
+
+bool send_line(int fd, const std::string& text) {
+  std::string data = text + "\n";
+  size_t sent = 0;
+
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+// Whether the client is still connected (it may have closed its writing end
+// only, but then it is still waiting for our answers)
+
+bool is_connected(int fd) {
+  pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = 0;
+  pfd.revents = 0;
+
+  return poll(&pfd, 1, 0) == 0 || !(pfd.revents & (POLLHUP | POLLERR));
+}
+
+// Serve a client until it closes the connection or sends "quit". If the client
+// disconnects while one of its queries is being analyzed, the analysis is
+// cancelled. Empty and malformed queries are answered with an error line, and
+// so are lines that are too long, which also close the connection.
+
+void handle_connection(Connection& connection, PIPELINE::Pool& pool) {
+  int fd = connection.fd;
+  std::string buffer, line;
+  QUERY::Answer answer;
+  char chunk[4096];
+  bool connected = true;
+
+  while (connected) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+
+    buffer.append(chunk, n);
+
+    size_t start = 0, end;
+    while (connected && (end = buffer.find('\n', start)) != std::string::npos) {
+      line = buffer.substr(start, end - start);
+      start = end + 1;
+
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+
+      if (line == "quit") {
+        connected = false;
+        break;
+      }
+
+      pool.analyze(line, answer, [fd]() { return is_connected(fd); });
+      connected = send_line(fd, answer.output);
+    }
+
+    buffer.erase(0, start);
+
+    if (connected && buffer.size() > MAX_LINE_LENGTH) {
+      send_line(fd, "error: line too long");
+      connected = false;
+    }
+  }
+
+  // The client sees the end of the connection now, the socket is closed when
+  // the thread is joined
+  shutdown(fd, SHUT_RDWR);
+  connection.finished = true;
+
+  char byte = 0;
+  while (write(connection.wakeup, &byte, 1) < 0 && errno == EINTR) {}
+}
+
+// Join the threads of the connections that are over and close their sockets
+
+void reap(std::list<Connection>& connections) {
+  for (auto it = connections.begin(); it != connections.end();)
+    if (it->finished) {
+      it->thread.join();
+      close(it->fd);
+      it = connections.erase(it);
+    } else
+      ++it;
+}
+
+}  // namespace
+
+void SERVER::serve(const std::string& socketPath,
+                   const QUERY::Settings& settings, int nbThreads) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  if (socketPath.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Socket path too long: " << socketPath << std::endl;
+    return;
+  }
+  std::strcpy(addr.sun_path, socketPath.c_str());
+
+  // A socket left by a previous server is replaced, anything else is kept
+  struct stat st;
+  if (lstat(socketPath.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      std::cerr << "Cannot listen on " << socketPath
+                << ": the file exists and is not a socket" << std::endl;
+      return;
+    }
+    unlink(socketPath.c_str());
+  }
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+      listen(listener, SOMAXCONN) < 0) {
+    std::cerr << "Cannot listen on " << socketPath << ": "
+              << std::strerror(errno) << std::endl;
+    return;
+  }
+
+  // Every connection must get an answer for every query, and no query may
+  // take larger budgets than those of the server
+  QUERY::Settings serverSettings = settings;
+  serverSettings.reportAll = true;
+  serverSettings.capBudgets = true;
+
+  PIPELINE::Pool pool(serverSettings, nbThreads);
+  std::cout << "Listening on " << socketPath << " (" << nbThreads
+            << " threads)" << std::endl;
+
+  // The server waits for new connections and for the end of the connections
+  // (signaled on the wakeup pipe)
+  int wakeup[2];
+  if (pipe(wakeup) < 0) {
+    std::cerr << "pipe: " << std::strerror(errno) << std::endl;
+    close(listener);
+    return;
+  }
+
+  std::list<Connection> connections;
+  pollfd fds[2] = {{listener, POLLIN, 0}, {wakeup[0], POLLIN, 0}};
+
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      std::cerr << "poll: " << std::strerror(errno) << std::endl;
+      break;
+    }
+
+    if (fds[1].revents & POLLIN) {
+      char bytes[64];
+      if (read(wakeup[0], bytes, sizeof(bytes)) > 0) reap(connections);
+    }
+
+    if (!(fds[0].revents & POLLIN)) continue;
+
+    int fd = accept(listener, nullptr, nullptr);
+
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      std::cerr << "accept: " << std::strerror(errno) << std::endl;
+      break;
+    }
+
+    reap(connections);
+
+    if (connections.size() >= MAX_CONNECTIONS) {
+      send_line(fd, "error: too many connections");
+      close(fd);
+      continue;
+    }
+
+    connections.emplace_back();
+    Connection& connection = connections.back();
+    connection.fd = fd;
+    connection.wakeup = wakeup[1];
+    connection.finished = false;
+    connection.thread =
+        std::thread(handle_connection, std::ref(connection), std::ref(pool));
+  }
+
+  // Wake up the clients still connected, they cannot be answered anymore
+  for (Connection& connection : connections)
+    shutdown(connection.fd, SHUT_RDWR);
+
+  for (Connection& connection : connections) {
+    connection.thread.join();
+    close(connection.fd);
+  }
+
+  close(wakeup[0]);
+  close(wakeup[1]);
+  close(listener);
+  unlink(socketPath.c_str());
+}
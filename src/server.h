@@ -0,0 +1,38 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#ifndef SERVER_H_INCLUDED
+#define SERVER_H_INCLUDED
+
+// In server mode, CHA stays resident and answers queries received through a
+// Unix domain socket, so that the initialization cost is paid only once.
+// Clients may open up to 64 concurrent connections, further connections get an
+// error line and are closed. On each connection, every line sent by the client
+// is a query (see query.h, it may carry its own mode and budgets, which cannot
+// exceed those of the server) and is answered with exactly one line, in order
+// (an error line for empty or malformed queries). Lines are limited to 4096
+// bytes, a longer line gets an error line and closes the connection.
+// The queries from all connections are answered by a common pool of threads.
+
+namespace SERVER {
+
+void serve(const std::string& socketPath, const QUERY::Settings& settings,
+           int nbThreads);
+
+}  // namespace SERVER
+
+#endif  // #ifndef SERVER_H_INCLUDED
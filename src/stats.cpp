@@ -0,0 +1,230 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#include "stockfish.h"
+#include "dynamic.h"
+#include "query.h"
+#include "stats.h"
+#include <math.h>
+
+// Values below SUB_BUCKETS have a bucket of their own. Otherwise, if the most
+// significant bit of the value is e, the bucket is determined by e and the
+// SUB_BITS bits that follow it.
+
+int STATS::Histogram::bucket(uint64_t value) {
+  if (value < SUB_BUCKETS) return int(value);
+
+  int e = 63 - __builtin_clzll(value);
+  int sub = int(value >> (e - SUB_BITS)) & (SUB_BUCKETS - 1);
+  return (e - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t STATS::Histogram::lower_bound(int b) {
+  if (b < SUB_BUCKETS) return b;
+
+  int e = b / SUB_BUCKETS + SUB_BITS - 1;
+  uint64_t sub = b % SUB_BUCKETS;
+  return (SUB_BUCKETS + sub) << (e - SUB_BITS);
+}
+
+uint64_t STATS::Histogram::upper_bound(int b) {
+  if (b < SUB_BUCKETS) return b;
+
+  int e = b / SUB_BUCKETS + SUB_BITS - 1;
+  return lower_bound(b) + ((uint64_t(1) << (e - SUB_BITS)) - 1);
+}
+
+void STATS::Histogram::add(uint64_t value) {
+  buckets[bucket(value)]++;
+  total++;
+  sumValues += value;
+  sumSquares += double(value) * double(value);
+  if (value > maxValue) maxValue = value;
+}
+
+uint64_t STATS::Histogram::count() const { return total; }
+
+uint64_t STATS::Histogram::sum() const { return sumValues; }
+
+uint64_t STATS::Histogram::max() const { return maxValue; }
+
+double STATS::Histogram::mean() const {
+  return total ? double(sumValues) / total : 0;
+}
+
+double STATS::Histogram::stddev() const {
+  if (!total) return 0;
+
+  double avg = mean();
+  double variance = sumSquares / total - avg * avg;
+  return variance > 0 ? sqrt(variance) : 0;
+}
+
+uint64_t STATS::Histogram::percentile(double p) const {
+  uint64_t rank = uint64_t(ceil(p / 100 * total));
+  uint64_t seen = 0;
+
+  for (int b = 0; b < N_BUCKETS; ++b) {
+    seen += buckets[b];
+    if (seen >= rank && seen > 0) return std::min(upper_bound(b), maxValue);
+  }
+  return maxValue;
+}
+
+void STATS::Histogram::dump(std::ostream& os) const {
+  for (int b = 0; b < N_BUCKETS; ++b)
+    if (buckets[b])
+      os << lower_bound(b) << " " << upper_bound(b) << " " << buckets[b]
+         << std::endl;
+}
+
+void STATS::Summary::add(const QUERY::Answer& answer) {
+  nodes += answer.nodes;
+  all.add(answer.duration);
+  byResult[answer.result].add(answer.duration);
+
+  if (answer.profiled)
+    for (int p = 0; p < DYNAMIC::PHASE_NB; ++p) {
+      if (!answer.phases[p].calls) continue;
+
+      byPhase[p].add(answer.phases[p].time);
+      for (int e = 0; e < PERF::EVENT_NB; ++e)
+        events[answer.result][p][e] += answer.phases[p].counters[e];
+    }
+}
+
+namespace {
+
+const char* ResultNames[] = {"winnable", "unwinnable", "undetermined",
+                             "cancelled"};
+
+void print_percentiles(std::ostream& os, const std::string& label,
+                       const STATS::Histogram& h) {
+  os << "  " << label << ": count " << h.count() << ", p50 "
+     << h.percentile(50) / 1000.0 << ", p90 " << h.percentile(90) / 1000.0
+     << ", p99 " << h.percentile(99) / 1000.0 << ", p99.9 "
+     << h.percentile(99.9) / 1000.0 << ", max " << h.max() / 1000.0
+     << std::endl;
+}
+
+// Cycles per position, instructions per cycle and misses per thousand
+// instructions
+
+void print_events(std::ostream& os, const std::string& label,
+                  const uint64_t events[PERF::EVENT_NB], uint64_t positions) {
+  double kiloInstructions = events[PERF::INSTRUCTIONS] / 1000.0;
+
+  if (!events[PERF::CYCLES] || !kiloInstructions) return;
+
+  os << "  " << label << ": cycles/pos " << events[PERF::CYCLES] / positions
+     << ", ipc " << double(events[PERF::INSTRUCTIONS]) / events[PERF::CYCLES]
+     << ", l1d mpki " << events[PERF::L1D_MISSES] / kiloInstructions
+     << ", llc mpki " << events[PERF::LLC_MISSES] / kiloInstructions
+     << ", branch mpki " << events[PERF::BRANCH_MISSES] / kiloInstructions
+     << std::endl;
+}
+
+}  // namespace
+
+// The summary line of the run, followed by the percentiles of latency (in
+// microseconds) of every class of results and phases that were seen
+
+void STATS::Summary::print(std::ostream& os) const {
+  os << "Analyzed " << all.count() << " "
+     << "positions in " << all.sum() / 1000 / 1000 << " ms "
+     << "(avg: " << all.mean() / 1000 << " us; "
+     << "std: " << all.stddev() / 1000 << " us; "
+     << "max: " << all.max() / 1000 << " us)" << std::endl;
+
+  if (!all.count()) return;
+
+  os << "Latency percentiles (us):" << std::endl;
+  print_percentiles(os, "all", all);
+
+  for (int r = 0; r < 4; ++r)
+    if (byResult[r].count()) print_percentiles(os, ResultNames[r], byResult[r]);
+
+  for (int p = 0; p < DYNAMIC::PHASE_NB; ++p)
+    if (byPhase[p].count())
+      print_percentiles(os, std::string("phase ") +
+                                DYNAMIC::phase_name(DYNAMIC::Phase(p)),
+                        byPhase[p]);
+
+  bool counted = false;
+  for (int r = 0; r < 4; ++r)
+    for (int p = 0; p < DYNAMIC::PHASE_NB; ++p)
+      counted = counted || events[r][p][PERF::CYCLES];
+
+  if (!counted) return;
+
+  os << "Hardware counters by result and phase:" << std::endl;
+
+  for (int r = 0; r < 4; ++r) {
+    if (!byResult[r].count()) continue;
+
+    uint64_t total[PERF::EVENT_NB] = {};
+    for (int p = 0; p < DYNAMIC::PHASE_NB; ++p)
+      for (int e = 0; e < PERF::EVENT_NB; ++e) total[e] += events[r][p][e];
+
+    print_events(os, ResultNames[r], total, byResult[r].count());
+
+    for (int p = 0; p < DYNAMIC::PHASE_NB; ++p)
+      print_events(os,
+                   std::string(ResultNames[r]) + " " +
+                       DYNAMIC::phase_name(DYNAMIC::Phase(p)),
+                   events[r][p], byResult[r].count());
+  }
+}
+
+// Dump all the non-empty histograms (values in nanoseconds), each one preceded
+// by a line "# <label>"
+
+void STATS::Summary::dump(std::ostream& os) const {
+  os << "# all" << std::endl;
+  all.dump(os);
+
+  for (int r = 0; r < 4; ++r)
+    if (byResult[r].count()) {
+      os << "# " << ResultNames[r] << std::endl;
+      byResult[r].dump(os);
+    }
+
+  for (int p = 0; p < DYNAMIC::PHASE_NB; ++p)
+    if (byPhase[p].count()) {
+      os << "# phase " << DYNAMIC::phase_name(DYNAMIC::Phase(p)) << std::endl;
+      byPhase[p].dump(os);
+    }
+}
+
+// Rates are computed over the wall-clock time, so that they are meaningful
+// when several analyzers run in parallel, latencies are in microseconds
+
+void STATS::Summary::report(std::ostream& os, uint64_t elapsed) const {
+  double seconds = elapsed / 1e9;
+
+  os << "positions " << all.count() << std::endl
+     << "nodes " << nodes << std::endl
+     << "elapsed_ms " << elapsed / 1000 / 1000 << std::endl
+     << "positions_per_sec " << (seconds > 0 ? all.count() / seconds : 0)
+     << std::endl
+     << "nodes_per_sec " << (seconds > 0 ? nodes / seconds : 0) << std::endl
+     << "p50_us " << all.percentile(50) / 1000.0 << std::endl
+     << "p90_us " << all.percentile(90) / 1000.0 << std::endl
+     << "p99_us " << all.percentile(99) / 1000.0 << std::endl
+     << "p999_us " << all.percentile(99.9) / 1000.0 << std::endl
+     << "max_us " << all.max() / 1000.0 << std::endl;
+}
@@ -0,0 +1,91 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+#include <iostream>
+
+#include "query.h"
+
+namespace STATS {
+
+// Histogram of values (latencies, in nanoseconds) with logarithmic buckets in
+// the style of HdrHistogram: every power of 2 is split into 2^SUB_BITS
+// buckets, so values are recorded with a relative error below 1/2^SUB_BITS,
+// in constant space and time.
+
+class Histogram {
+ public:
+  static constexpr int SUB_BITS = 4;
+  static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+  static constexpr int N_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+  void add(uint64_t value);
+
+  uint64_t count() const;
+  uint64_t sum() const;
+  uint64_t max() const;
+  double mean() const;
+  double stddev() const;
+
+  // The smallest recorded value v (up to the bucket precision) such that
+  // [p]% of the recorded values are less than or equal to v
+  uint64_t percentile(double p) const;
+
+  // Non-empty buckets, one per line: "<lower bound> <upper bound> <count>"
+  void dump(std::ostream& os) const;
+
+ private:
+  static int bucket(uint64_t value);
+  static uint64_t lower_bound(int bucket);
+  static uint64_t upper_bound(int bucket);
+
+  // Data members
+  uint64_t buckets[N_BUCKETS] = {};
+  uint64_t total = 0;
+  uint64_t sumValues = 0;
+  double sumSquares = 0;  // In double, squares of nanoseconds overflow
+  uint64_t maxValue = 0;
+};
+
+// Latencies of a run of queries, by result and by phase of the analysis
+// (the latter only if the phases are profiled), and hardware events by result
+// and phase (only in -perfcounters mode)
+
+class Summary {
+ public:
+  void add(const QUERY::Answer& answer);
+
+  void print(std::ostream& os) const;
+  void dump(std::ostream& os) const;
+
+  // Machine-readable figures of the run, one "<key> <value>" per line, given
+  // its wall-clock time (in nanoseconds)
+  void report(std::ostream& os, uint64_t elapsed) const;
+
+ private:
+  uint64_t nodes = 0;
+  Histogram all;
+  Histogram byResult[4];  // Indexed by DYNAMIC::SearchResult
+  Histogram byPhase[DYNAMIC::PHASE_NB];
+  uint64_t events[4][DYNAMIC::PHASE_NB][PERF::EVENT_NB] = {};
+};
+
+}  // namespace STATS
+
+#endif  // #ifndef STATS_H_INCLUDED
@@ -19,7 +19,12 @@
 #include "util.h"
 #include "semistatic.h"
 #include "dynamic.h"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 // Every lime must contained two characters followed by a space and a FEN
 // These characters represent the expected evaluation of the position:
@@ -87,10 +92,7 @@ void analyze(std::string &line, Color winner, Position &pos,
 
 // loop() waits for a test line from stdin and analyzes it.
 
-void loop(int argc, char *argv[]) {
-  KnightDistance::init();
-  SemiStatic::init();
-
+void loop() {
   Position pos;
   std::string token, line;
   StateListPtr states(new std::deque<StateInfo>(1));
@@ -109,9 +111,6 @@ void loop(int argc, char *argv[]) {
   while (getline(std::cin, line)) {
     if (line[0] == '#') continue;
 
-    DYNAMIC::SearchResult result;
-    std::string expected = parse_line(pos, &states->back(), line);
-
     analyze(line, WHITE, pos, states, search, totalNodes, maxNodes,
             totalPositions, totalSolved, totalPreStatic, totalStatic);
 
@@ -137,11 +136,378 @@ void loop(int argc, char *argv[]) {
   Threads.stop = true;
 }
 
+// compare_kernels() checks the semistatic saturation on every test position:
+// the scalar and the AVX2 frontier kernels must reach the same variables (if
+// AVX2 is supported), and a Batch saturating the children of the position
+// together must reach the same variables as a System saturating each child on
+// its own.
+
+int compare_kernels() {
+  Position pos;
+  std::string line;
+  StateListPtr states(new std::deque<StateInfo>(1));
+  StateInfo st;
+  bool avx2Supported = SemiStatic::best_kernel() == SemiStatic::AVX2;
+
+  if (!avx2Supported)
+    std::cout << "AVX2 is not supported, only batches are compared"
+              << std::endl;
+
+  std::unique_ptr<SemiStatic::System> scalar(new SemiStatic::System());
+  std::unique_ptr<SemiStatic::System> avx2(new SemiStatic::System());
+  std::unique_ptr<SemiStatic::System> single(new SemiStatic::System());
+  std::unique_ptr<SemiStatic::System> cached(new SemiStatic::System());
+  std::unique_ptr<SemiStatic::Batch> batch(new SemiStatic::Batch());
+  scalar->set_kernel(SemiStatic::SCALAR);
+  avx2->set_kernel(SemiStatic::AVX2);
+
+  uint64_t totalPositions = 0;
+  uint64_t totalMismatches = 0;
+  uint64_t totalChildren = 0;
+  uint64_t totalBatchMismatches = 0;
+  uint64_t totalCacheMismatches = 0;
+
+  while (getline(std::cin, line)) {
+    if (line[0] == '#') continue;
+
+    parse_line(pos, &states->back(), line);
+    totalPositions++;
+
+    if (avx2Supported) {
+      scalar->saturate(pos);
+      avx2->saturate(pos);
+
+      if (!scalar->same_variables(*avx2)) {
+        totalMismatches++;
+        std::cout << "Kernels differ! (" << line << ")" << std::endl;
+      }
+    }
+
+    batch->clear();
+    for (const ExtMove& m : MoveList<LEGAL>(pos)) {
+      pos.do_move(m, st);
+      batch->add(pos);
+      pos.undo_move(m);
+    }
+    batch->saturate();
+
+    size_t i = 0;
+    for (const ExtMove& m : MoveList<LEGAL>(pos)) {
+      pos.do_move(m, st);
+      single->saturate(pos);
+      // The second saturation is served by the cache
+      cached->saturate_cached(pos);
+      cached->saturate_cached(pos);
+      pos.undo_move(m);
+      totalChildren++;
+
+      if (!single->same_variables(*cached)) {
+        totalCacheMismatches++;
+        std::cout << "Cache differs after " << UCI::move(m, false) << "! ("
+                  << line << ")" << std::endl;
+      }
+
+      if (!single->same_variables(batch->system(i++))) {
+        totalBatchMismatches++;
+        std::cout << "Batch differs after " << UCI::move(m, false) << "! ("
+                  << line << ")" << std::endl;
+      }
+    }
+  }
+
+  std::cout << "positions: " << totalPositions << std::endl;
+  std::cout << "mismatches: " << totalMismatches << std::endl;
+  std::cout << "children: " << totalChildren << std::endl;
+  std::cout << "batch mismatches: " << totalBatchMismatches << std::endl;
+  std::cout << "cache mismatches: " << totalCacheMismatches << std::endl;
+
+  Threads.stop = true;
+  return totalMismatches || totalBatchMismatches || totalCacheMismatches ? 1 : 0;
+}
+
+// cancel_after() runs [analysis] and sets [cancelled] from another thread
+// after [delay] milliseconds, unless the analysis has finished before.
+
+template <typename Analysis>
+void cancel_after(int delay, std::atomic<bool> &cancelled, Analysis analysis) {
+  std::mutex mutex;
+  std::condition_variable finished;
+  bool done = false;
+
+  cancelled = false;
+
+  std::thread canceller([&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!finished.wait_for(lock, std::chrono::milliseconds(delay),
+                           [&]() { return done; }))
+      cancelled = true;
+  });
+
+  analysis();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  finished.notify_one();
+  canceller.join();
+}
+
+// The fixture of the checks below: the position of the test line, the searches
+// of both players (the one of Black has its own table, for dead_analysis) and
+// the failures found. The searches are zero-initialized, like static ones.
+
+struct Fixture {
+  Position pos;
+  StateListPtr states{new std::deque<StateInfo>(1)};
+  DYNAMIC::Search search{};
+  DYNAMIC::Search black{};
+  TranspositionTable blackTT{};
+  uint64_t failures = 0;
+
+  Fixture() {
+    uint64_t globalLimit = 10000000;
+
+    black.set_tt(&blackTT, size_t(Options["Hash"]));
+    search.set_limit(globalLimit);
+    black.set_limit(globalLimit);
+  }
+
+  // The analyses advance the position, it must be set again before each one
+  std::string set(std::string &line) {
+    return parse_line(pos, &states->back(), line);
+  }
+};
+
+// for_each_line() calls [check] on every test line (and its expected
+// evaluation) from stdin, with the position of the fixture set.
+
+template <typename Check>
+void for_each_line(Fixture &f, Check check) {
+  std::string line;
+
+  while (getline(std::cin, line)) {
+    if (line[0] == '#') continue;
+
+    std::string expected = f.set(line);
+    check(line, expected);
+  }
+
+  Threads.stop = true;
+}
+
+// check_cancellation() cancels the analyses of every test position (for each
+// player that is expected to be able to win) after several delays, and checks
+// that they are never found unwinnable: a cancelled analysis proves nothing.
+// The analyses advance the position, so it is parsed again before each one.
+
+int check_cancellation() {
+  const int delays[] = {0, 1, 10, 100};
+  Fixture f;
+  std::atomic<bool> cancelled(false);
+
+  f.search.set_cancel_flag(&cancelled);
+  f.black.set_cancel_flag(&cancelled);
+
+  uint64_t totalAnalyses = 0;
+  uint64_t totalCancelled = 0;
+
+  auto check = [&](DYNAMIC::SearchResult result, const std::string &line,
+                   const std::string &analysis) {
+    totalAnalyses++;
+
+    if (result == DYNAMIC::CANCELLED) totalCancelled++;
+
+    if (result == DYNAMIC::UNWINNABLE) {
+      f.failures++;
+      std::cout << "Test failed! unwinnable after cancellation (" << line
+                << " " << analysis << ")" << std::endl;
+    }
+  };
+
+  for_each_line(f, [&](std::string &line, const std::string &expected) {
+    bool winnable[COLOR_NB] = {expected[0] == 'W', expected[1] == 'B'};
+
+    for (int delay : delays) {
+      for (Color winner : {WHITE, BLACK}) {
+        if (!winnable[winner]) continue;
+
+        f.set(line);
+        f.search.set_winner(winner);
+        cancel_after(delay, cancelled,
+                     [&]() { DYNAMIC::full_analysis(f.pos, f.search); });
+        check(f.search.get_result(), line,
+              winner == WHITE ? "white" : "black");
+      }
+
+      if (!winnable[WHITE] && !winnable[BLACK]) continue;
+
+      f.set(line);
+      cancel_after(delay, cancelled, [&]() {
+        DYNAMIC::dead_analysis(f.pos, f.search, f.black);
+      });
+      for (Color winner : {WHITE, BLACK})
+        if (winnable[winner])
+          check((winner == WHITE ? f.search : f.black).get_result(), line,
+                winner == WHITE ? "dead white" : "dead black");
+    }
+  });
+
+  std::cout << "analyses: " << totalAnalyses << std::endl;
+  std::cout << "cancelled: " << totalCancelled << std::endl;
+  std::cout << "failures: " << f.failures << std::endl;
+
+  return f.failures ? 1 : 0;
+}
+
+// check_dead() runs dead_analysis on every test position and checks it
+// against the expected evaluation (unwinnable if and only if it is '--') and
+// against two separate full analyses (one per player), which must reach the
+// same verdict whenever both are decided. It also reports the nodes of both
+// ways of checking whether a position is dead.
+
+int check_dead() {
+  Fixture f;
+
+  uint64_t totalPositions = 0;
+  uint64_t totalUndetermined = 0;
+  uint64_t deadNodes = 0;
+  uint64_t separateNodes = 0;
+
+  auto name = [](DYNAMIC::SearchResult result) {
+    return result == DYNAMIC::WINNABLE     ? "winnable"
+           : result == DYNAMIC::UNWINNABLE ? "unwinnable"
+                                           : "undetermined";
+  };
+
+  for_each_line(f, [&](std::string &line, const std::string &expected) {
+    bool dead = expected == "--";
+
+    DYNAMIC::SearchResult result =
+        DYNAMIC::dead_analysis(f.pos, f.search, f.black);
+    deadNodes += f.search.get_nb_nodes() + f.black.get_nb_nodes();
+
+    // The same question, answered by two separate full analyses
+    DYNAMIC::SearchResult separate[COLOR_NB];
+    for (Color winner : {WHITE, BLACK}) {
+      f.set(line);
+      f.search.set_winner(winner);
+      separate[winner] = DYNAMIC::full_analysis(f.pos, f.search);
+      separateNodes += f.search.get_nb_nodes();
+    }
+
+    DYNAMIC::SearchResult reference =
+        separate[WHITE] == DYNAMIC::WINNABLE ||
+                separate[BLACK] == DYNAMIC::WINNABLE
+            ? DYNAMIC::WINNABLE
+        : separate[WHITE] == DYNAMIC::UNWINNABLE &&
+                separate[BLACK] == DYNAMIC::UNWINNABLE
+            ? DYNAMIC::UNWINNABLE
+            : DYNAMIC::UNDETERMINED;
+
+    totalPositions++;
+
+    if (result == DYNAMIC::UNDETERMINED || reference == DYNAMIC::UNDETERMINED) {
+      totalUndetermined++;
+      std::cout << "undetermined dead " << name(result) << " separate "
+                << name(reference) << " (" << line << ")" << std::endl;
+    }
+
+    if ((result == DYNAMIC::UNWINNABLE && !dead) ||
+        (result == DYNAMIC::WINNABLE && dead) ||
+        (result != DYNAMIC::UNDETERMINED &&
+         reference != DYNAMIC::UNDETERMINED && result != reference)) {
+      f.failures++;
+      std::cout << "Test failed! dead " << name(result) << " separate "
+                << name(reference) << " (" << line << ")" << std::endl;
+    }
+  });
+
+  std::cout << "positions: " << totalPositions << std::endl;
+  std::cout << "undetermined: " << totalUndetermined << std::endl;
+  std::cout << "failures: " << f.failures << std::endl;
+  std::cout << "nodes (dead_analysis): " << deadNodes << std::endl;
+  std::cout << "nodes (full_analysis x2): " << separateNodes << std::endl;
+
+  return f.failures ? 1 : 0;
+}
+
+// check_pruning() analyzes every test position (for each player) with and
+// without the semistatic pruning of find_mate, and checks that the pruning
+// never changes a decided verdict, nor proves unwinnable a player that is
+// expected to be able to win. It also reports the nodes of both analyses.
+
+int check_pruning() {
+  Fixture f;
+
+  uint64_t totalAnalyses = 0;
+  uint64_t nodes[2] = {0, 0};  // Without and with pruning
+
+  for_each_line(f, [&](std::string &line, const std::string &expected) {
+    for (Color winner : {WHITE, BLACK}) {
+      bool winnable = expected[winner] == (winner == WHITE ? 'W' : 'B');
+      DYNAMIC::SearchResult results[2];
+
+      for (bool pruning : {false, true}) {
+        f.set(line);
+        f.search.set_winner(winner);
+        f.search.set_pruning(pruning);
+        results[pruning] = DYNAMIC::full_analysis(f.pos, f.search);
+        nodes[pruning] += f.search.get_nb_nodes();
+      }
+
+      totalAnalyses++;
+
+      if ((results[true] == DYNAMIC::UNWINNABLE && winnable) ||
+          (results[false] != DYNAMIC::UNDETERMINED &&
+           results[true] != DYNAMIC::UNDETERMINED &&
+           results[false] != results[true])) {
+        f.failures++;
+        std::cout << "Test failed! pruning changes the verdict (" << line
+                  << " " << (winner == WHITE ? "white" : "black") << ")"
+                  << std::endl;
+      }
+    }
+  });
+
+  std::cout << "analyses: " << totalAnalyses << std::endl;
+  std::cout << "failures: " << f.failures << std::endl;
+  std::cout << "nodes (without pruning): " << nodes[false] << std::endl;
+  std::cout << "nodes (with pruning): " << nodes[true] << std::endl;
+
+  return f.failures ? 1 : 0;
+}
+
 int main(int argc, char *argv[]) {
   init_stockfish();
 
   CommandLine::init(argc, argv);
-  loop(argc, argv);
+
+  if (argc > 1 && std::string(argv[1]) == "kernels") {
+    int status = compare_kernels();
+    Threads.set(0);
+    return status;
+  }
+
+  if (argc > 1 && std::string(argv[1]) == "cancel") {
+    int status = check_cancellation();
+    Threads.set(0);
+    return status;
+  }
+
+  if (argc > 1 && std::string(argv[1]) == "pruning") {
+    int status = check_pruning();
+    Threads.set(0);
+    return status;
+  }
+
+  if (argc > 1 && std::string(argv[1]) == "dead") {
+    int status = check_dead();
+    Threads.set(0);
+    return status;
+  }
+
+  loop();
 
   Threads.set(0);
   return 0;
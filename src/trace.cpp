@@ -0,0 +1,91 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#include "stockfish.h"
+#include "trace.h"
+#include <map>
+
+namespace {
+
+// Indexed by VariationType (see dynamic.cpp)
+const char* VariationNames[] = {"normal", "reward", "punish"};
+
+int variation_at(const TRACE::Event& e, int ply) {
+  return int(e.path[ply / 32] >> (2 * (ply % 32))) & 3;
+}
+
+// Labels are queries, only quotes and backslashes need escaping
+std::string escape(const std::string& s) {
+  std::string escaped;
+  for (char c : s) {
+    if (c == '"' || c == '\\') escaped += '\\';
+    escaped += c;
+  }
+  return escaped;
+}
+
+}  // namespace
+
+void TRACE::Tracer::reset(uint64_t samplePeriod) {
+  buffer.resize(CAPACITY);
+  written = 0;
+  sample = countdown = std::max(samplePeriod, uint64_t(1));
+}
+
+void TRACE::Tracer::events(std::vector<Event>& out) const {
+  uint64_t n = std::min(written, uint64_t(CAPACITY));
+  out.resize(n);
+
+  for (uint64_t i = 0; i < n; ++i)
+    out[i] = buffer[(written - n + i) % CAPACITY];
+}
+
+void TRACE::write_collapsed(std::ostream& os, const std::string& label,
+                            const std::vector<Event>& events) {
+  std::map<std::string, uint64_t> stacks;
+
+  for (const Event& e : events) {
+    std::string stack = label;
+    for (int ply = 0; ply <= e.ply && ply < MAX_PATH; ++ply)
+      stack += std::string(";") + VariationNames[variation_at(e, ply)];
+
+    stacks[stack]++;
+  }
+
+  for (const auto& s : stacks) os << s.first << " " << s.second << std::endl;
+}
+
+void TRACE::begin_chrome(std::ostream& os) {
+  os << "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+     << "\"args\":{\"name\":\"cha\"}}";
+}
+
+void TRACE::write_chrome(std::ostream& os, int pid, const std::string& label,
+                         const std::vector<Event>& events) {
+  os << ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+     << ",\"args\":{\"name\":\"" << escape(label) << "\"}}";
+
+  for (const Event& e : events)
+    os << ",\n{\"name\":\"" << VariationNames[e.variation]
+       << "\",\"cat\":\"find_mate\",\"ph\":\"X\",\"ts\":" << e.node
+       << ",\"dur\":1,\"pid\":" << pid << ",\"tid\":" << e.ply
+       << ",\"args\":{\"move\":\"" << UCI::move(e.move, false)
+       << "\",\"depth\":" << e.depth << ",\"newDepth\":" << e.newDepth
+       << "}}";
+}
+
+void TRACE::end_chrome(std::ostream& os) { os << "]" << std::endl; }
@@ -0,0 +1,108 @@
+/*
+  Chess Unwinnability Analyzer, an implementation of a decision procedure for
+  checking whether a certain player can deliver checkmate (i.e. win) in a given
+  chess position.
+
+  This software leverages Stockfish as a backend for chess-related functions.
+  Stockfish is free software provided under the GNU General Public License
+  (see <http://www.gnu.org/licenses/>) and so is this tool.
+  The full source code of Stockfish can be found here:
+  <https://github.com/official-stockfish/Stockfish>.
+
+  Chess Unwinnability Analyzer is distributed in the hope that it will be
+  useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU GPL for more
+  details.
+*/
+
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace TRACE {
+
+// Tracing of the search tree of find_mate. Every move explored by find_mate
+// is visited, and one out of every [sample] visits is recorded in a ring
+// buffer (so only the last CAPACITY samples are kept). Samples contain the
+// variation types (normal, reward, punish) of the whole path from the root,
+// so that they can be aggregated as a flamegraph.
+
+constexpr int CAPACITY = 1 << 16;
+constexpr int MAX_PATH = 64;  // Deeper plies are not recorded in the path
+
+struct Event {
+  uint64_t node;     // Nodes searched when the event was sampled
+  uint64_t path[2];  // Variation types of the path, 2 bits per ply
+  Move move;
+  int16_t ply;
+  int16_t depth;
+  int16_t newDepth;
+  uint8_t variation;
+};
+
+class Tracer {
+ public:
+  void reset(uint64_t samplePeriod);
+
+  // Called when a search starts: the path of the previous search is reset to
+  // normal variations (plies before the new root are never visited)
+  void start();
+
+  void visit(int ply, Move m, int variation, Depth depth, Depth newDepth,
+             uint64_t node);
+
+  // The recorded events, oldest first
+  void events(std::vector<Event>& out) const;
+
+ private:
+  std::vector<Event> buffer;
+  uint64_t written = 0;
+  uint64_t sample = 1;
+  uint64_t countdown = 1;
+  uint8_t path[MAX_PATH] = {};
+};
+
+inline void Tracer::start() { std::fill(path, path + MAX_PATH, uint8_t(0)); }
+
+inline void Tracer::visit(int ply, Move m, int variation, Depth depth,
+                          Depth newDepth, uint64_t node) {
+  if (ply < MAX_PATH) path[ply] = uint8_t(variation);
+
+  if (--countdown) return;
+
+  countdown = sample;
+
+  Event& e = buffer[written++ % CAPACITY];
+  e.node = node;
+  e.path[0] = e.path[1] = 0;
+  for (int i = 0; i <= ply && i < MAX_PATH; ++i)
+    e.path[i / 32] |= uint64_t(path[i]) << (2 * (i % 32));
+  e.move = m;
+  e.ply = int16_t(ply);
+  e.depth = int16_t(depth);
+  e.newDepth = int16_t(newDepth);
+  e.variation = uint8_t(variation);
+}
+
+// Exports of the events of one query, labelled by the query itself:
+//  * collapsed : one line per distinct path, "<label>;<type>;<type>... count",
+//                as expected by flamegraph.pl
+//  * chrome    : Chrome trace events (to be wrapped in a JSON array, see
+//                begin_chrome/end_chrome), one lane per ply and one process
+//                per query, with the node count as timestamp
+
+void write_collapsed(std::ostream& os, const std::string& label,
+                     const std::vector<Event>& events);
+
+void begin_chrome(std::ostream& os);
+void write_chrome(std::ostream& os, int pid, const std::string& label,
+                  const std::vector<Event>& events);
+void end_chrome(std::ostream& os);
+
+}  // namespace TRACE
+
+#endif  // #ifndef TRACE_H_INCLUDED
@@ -19,64 +19,103 @@
 #include "util.h"
 
 
+// The tables below are generated at compile time, so they live in read-only
+// data (shared by all the processes running CHA) and need no initialization.
+
+namespace {
+
 constexpr int NONE = 128;  // High enough to go outside of the board
 
-int PAWN_INCS[8] = {-8, -7, -9, NONE, NONE, NONE, NONE, NONE};
-int KNIGHT_INCS[8] = {17, 15, 10, 6, -6, -10, -15, -17};
-int BISHOP_INCS[8] = {9, 7, -7, -9, NONE, NONE, NONE, NONE};
-int ROOK_INCS[8] = {8, 1, -1, -8, NONE, NONE, NONE, NONE};
-int QUEEN_INCS[8] = {9, 8, 7, 1, -1, -7, -8, -9};
-int KING_INCS[8] = {9, 8, 7, 1, -1, -7, -8, -9};
+constexpr int INCREMENTS[6][8] = {
+    {-8, -7, -9, NONE, NONE, NONE, NONE, NONE},  // Pawn
+    {17, 15, 10, 6, -6, -10, -15, -17},           // Knight
+    {9, 7, -7, -9, NONE, NONE, NONE, NONE},       // Bishop
+    {8, 1, -1, -8, NONE, NONE, NONE, NONE},       // Rook
+    {9, 8, 7, 1, -1, -7, -8, -9},                 // Queen
+    {9, 8, 7, 1, -1, -7, -8, -9}};                // King
 
-int* INCREMENTS[6] = {PAWN_INCS, KNIGHT_INCS, BISHOP_INCS,
-                      ROOK_INCS, QUEEN_INCS,  KING_INCS};
+constexpr int abs_diff(int x, int y) { return x > y ? x - y : y - x; }
 
-bool overflow(Square source, Square target) {
-  return abs((source % 8) - (target % 8)) > 2 || target < SQ_A1 ||
-         target > SQ_H8;
+constexpr int chebyshev(int x, int y) {
+  return std::max(abs_diff(x % 8, y % 8), abs_diff(x / 8, y / 8));
 }
 
-void UTIL::unmove(Square* presquares, PieceType p, Color c, Square s) {
-  int i = 0;
-  int direction = (c == WHITE) ? 1 : -1;
+constexpr bool overflow(int source, int target) {
+  return target < SQ_A1 || target > SQ_H8 ||
+         abs_diff(source % 8, target % 8) > 2;
+}
 
-  for (int j = 0; j < 8; ++j) {
-    Square prev = static_cast<Square>(s + direction * INCREMENTS[p - 1][j]);
-    if (overflow(s, prev)) continue;
+constexpr UTIL::PredecessorTable make_predecessors() {
+  UTIL::PredecessorTable table{};
 
-    presquares[i] = prev;
-    i++;
-  }
-  while (i < 8) presquares[i++] = static_cast<Square>(-1);
+  for (int p = 0; p < 6; ++p)
+    for (int c = 0; c < COLOR_NB; ++c)
+      for (int s = SQ_A1; s <= SQ_H8; ++s) {
+        int i = 0;
+        int direction = (c == WHITE) ? 1 : -1;
+
+        for (int j = 0; j < 8; ++j) {
+          int prev = s + direction * INCREMENTS[p][j];
+          if (overflow(s, prev)) continue;
+
+          table.squares[p][c][s][i++] = int8_t(prev);
+          table.successors[p][c][prev] |= 1ULL << s;
+        }
+        while (i < 8) table.squares[p][c][s][i++] = -1;
+      }
+
+  return table;
 }
 
-Bitboard UTIL::neighbours(Square s) {
-  Bitboard sNeighbours = 0;
-  Square presquares[8];
-  unmove(presquares, KING, WHITE, s);  // Color does not matter
-  for (int j = 0; j < 8; ++j) {
-    if (presquares[j] < 0) break;
-    sNeighbours |= presquares[j];
-  }
-  return sNeighbours;
+struct DistanceTable {
+  Bitboard squares[3][SQUARE_NB];  // Squares at distance 0, 1 and 2
+};
+
+constexpr DistanceTable make_distances() {
+  DistanceTable table{};
+
+  for (int s = SQ_A1; s <= SQ_H8; ++s)
+    for (int t = SQ_A1; t <= SQ_H8; ++t)
+      if (chebyshev(s, t) <= 2)
+        table.squares[chebyshev(s, t)][s] |= 1ULL << t;
+
+  return table;
+}
+
+constexpr DistanceTable Distances = make_distances();
+
+}  // namespace
+
+constexpr UTIL::PredecessorTable UTIL::PREDECESSORS = make_predecessors();
+
+void UTIL::unmove(Square* presquares, PieceType p, Color c, Square s) {
+  for (int j = 0; j < 8; ++j)
+    presquares[j] = Square(PREDECESSORS.squares[p - 1][c][s][j]);
 }
 
+int UTIL::occupied_files(Bitboard b) {
+  b |= b >> 32;
+  b |= b >> 16;
+  b |= b >> 8;
+  return int(b & 0xFF);
+}
+
+Bitboard UTIL::king_spread(Bitboard b) {
+  Bitboard rows = b | shift<EAST>(b) | shift<WEST>(b);
+  return rows | shift<NORTH>(rows) | shift<SOUTH>(rows);
+}
+
+Bitboard UTIL::neighbours(Square s) { return Distances.squares[1][s]; }
+
 // squares at exactly king-distance 2 of s
 
 Bitboard UTIL::neighbours_distance_2(Square s) {
-  Bitboard sNeighbours = 0;
-  for (Square t = SQ_A1; t <= SQ_H8; ++t)
-    if (distance<Square>(s, t) == 2) sNeighbours |= square_bb(t);
-
-  return sNeighbours;
+  return Distances.squares[2][s];
 }
 
 Square UTIL::find_king(Position& pos, Color c) {
-  Square s;
   Bitboard king = pos.pieces(c, KING);
-  for (s = SQ_A1; s <= SQ_H8; ++s)
-    if (king & s) break;
-  return s;
+  return king ? lsb(king) : SQ_NONE;
 }
 
 // Returns the number of white pawns that are blocked by a black pawn
@@ -91,19 +130,11 @@ int UTIL::nb_blocked_pawns(Position& pos) {
 // A pawn is said to be "lonely" if there are no opponent pawns in its file
 
 bool UTIL::has_lonely_pawns(Position& pos) {
-  Bitboard whitePawns = pos.pieces(WHITE, PAWN);
-  Bitboard blackPawns = pos.pieces(BLACK, PAWN);
+  // Pawns on the last two ranks (of their color) are not taken into account
+  Bitboard whitePawns = pos.pieces(WHITE, PAWN) & ~(Rank7BB | Rank8BB);
+  Bitboard blackPawns = pos.pieces(BLACK, PAWN) & ~(Rank1BB | Rank2BB);
 
-  int whitePawnOcc = 0;
-  int blackPawnOcc = 0;
-
-  for (Square s = SQ_A1; s <= SQ_H8; ++s) {
-    if ((whitePawns & s) && s < SQ_A7) whitePawnOcc |= (1 << s % 8);
-
-    if ((blackPawns & s) && s > SQ_H2) blackPawnOcc |= (1 << s % 8);
-  }
-
-  return whitePawnOcc != blackPawnOcc;
+  return occupied_files(whitePawns) != occupied_files(blackPawns);
 }
 
 // Looks for a two opposing pawns with just a square in between.
@@ -114,15 +145,13 @@ bool UTIL::semi_blocked_target(Position& pos, Square& target) {
   Bitboard whitePawns = pos.pieces(WHITE, PAWN);
   Bitboard blackPawns = pos.pieces(BLACK, PAWN);
 
+  // Always between the 3rd and the 6th ranks
   Bitboard inBetween = whitePawns << 8 & blackPawns >> 8;
 
-  for (Square s = SQ_A3; s <= SQ_H6; ++s)
-    if (inBetween & s) {
-      target = s;
-      return true;
-    }
+  if (!inBetween) return false;
 
-  return false;
+  target = lsb(inBetween);
+  return true;
 }
 
 bool UTIL::is_corner(Square s) {
@@ -154,55 +183,59 @@ void UTIL::trivial_progress(Position& pos, StateInfo& st, int repetitions) {
 // Exceptionally, distance(SQ_A8, SQ_B7) = 4 cannot be computed from the
 // tables, as well as the symmetric cases in other corners.
 
-int KnightDistance::knight_distance(Square x, Square y) {
-  std::pair<int, int> idx =
-      std::minmax(distance<File>(x, y), distance<Rank>(x, y));
+namespace {
+
+constexpr bool corner(int s) {
+  return s == SQ_A1 || s == SQ_H1 || s == SQ_A8 || s == SQ_H8;
+}
+
+constexpr int knight_distance(int x, int y) {
+  int first = std::min(abs_diff(x % 8, y % 8), abs_diff(x / 8, y / 8));
+  int second = std::max(abs_diff(x % 8, y % 8), abs_diff(x / 8, y / 8));
 
   // Handle the exceptional cases
 
-  if (idx.first == 1 && idx.second == 1 &&
-      (UTIL::is_corner(x) || UTIL::is_corner(y)))
-    return 4;
+  if (first == 1 && second == 1 && (corner(x) || corner(y))) return 4;
 
   // First and second tables
-  if (idx.first % 2 == idx.second % 2) {
-    if (idx.first == 0 && idx.second == 0) return 0;
-    if (idx.first == 0 && idx.second == 2) return 2;
-    if (idx.first == 0 && idx.second == 4) return 2;
-    if (idx.first == 2 && idx.second == 4) return 2;
+  if (first % 2 == second % 2) {
+    if (first == 0 && second == 0) return 0;
+    if (first == 0 && second == 2) return 2;
+    if (first == 0 && second == 4) return 2;
+    if (first == 2 && second == 4) return 2;
 
-    if (idx.first == 1 && idx.second == 1) return 2;
-    if (idx.first == 1 && idx.second == 3) return 2;
-    if (idx.first == 3 && idx.second == 3) return 2;
-    if (idx.first == 7 && idx.second == 7) return 6;
+    if (first == 1 && second == 1) return 2;
+    if (first == 1 && second == 3) return 2;
+    if (first == 3 && second == 3) return 2;
+    if (first == 7 && second == 7) return 6;
 
     return 4;
   }
 
   // Third table
   else {
-    if (idx.second == 7) return 5;
-    if (idx.first == 1 && idx.second == 2) return 1;
-    if (idx.first == 5 && idx.second == 6) return 5;
+    if (second == 7) return 5;
+    if (first == 1 && second == 2) return 1;
+    if (first == 5 && second == 6) return 5;
 
     return 3;
   }
 }
 
-// In practice, instead of calling the above function all the time, we can store
-// the distances between any two squares in an array. Is this really faster?
+constexpr KnightDistance::Table make_knight_distances() {
+  KnightDistance::Table table{};
 
-static int KnightDistanceTable[4096];  // 64 * 64 = 4096
+  for (int x = SQ_A1; x <= SQ_H8; ++x)
+    for (int y = SQ_A1; y <= SQ_H8; ++y)
+      table.distances[x][y] = int8_t(knight_distance(x, y));
 
-inline unsigned index(Square x, Square y) { return int(x) | (y << 6); }
-
-void KnightDistance::init() {
-  for (Square x = SQ_A1; x <= SQ_H8; ++x) {
-    for (Square y = SQ_A1; y <= SQ_H8; ++y)
-      KnightDistanceTable[index(x, y)] = knight_distance(x, y);
-  }
+  return table;
 }
 
-int KnightDistance::get(Square x, Square y) {
-  return KnightDistanceTable[index(x, y)];
+}  // namespace
+
+constexpr KnightDistance::Table KnightDistance::TABLE = make_knight_distances();
+
+int KnightDistance::knight_distance(Square x, Square y) {
+  return ::knight_distance(x, y);
 }
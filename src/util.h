@@ -20,6 +20,23 @@
 
 namespace UTIL {
 
+// Bitboard primitives
+
+int occupied_files(Bitboard b);    // One bit per file, bit 0 for file A
+Bitboard king_spread(Bitboard b);  // b and all the squares adjacent to b
+
+// The squares from which a piece of type p + 1 and color c moves to t, for
+// every (p, c, t), in the order of the movement equations of the semistatic
+// analysis (for pawns, the push comes first), padded with -1. The successors
+// of u are the squares t that have u among their predecessors.
+
+struct PredecessorTable {
+  int8_t squares[6][COLOR_NB][SQUARE_NB][8];
+  Bitboard successors[6][COLOR_NB][SQUARE_NB];
+};
+
+extern const PredecessorTable PREDECESSORS;
+
 void unmove(Square* presquares, PieceType p, Color c, Square s);
 Bitboard neighbours(Square s);
 Bitboard neighbours_distance_2(Square s);
@@ -36,10 +53,15 @@ void trivial_progress(Position& pos, StateInfo& st, int repetitions);
 
 namespace KnightDistance {
 
+struct Table {
+  int8_t distances[SQUARE_NB][SQUARE_NB];
+};
+
+extern const Table TABLE;
+
 int knight_distance(Square x, Square y);
 
-void init();
-int get(Square x, Square y);
+inline int get(Square x, Square y) { return TABLE.distances[x][y]; }
 
 }  // namespace KnightDistance
 
@@ -0,0 +1,68 @@
+#!/bin/sh
+#
+#  Performance benchmark for Chess Unwinnability Analyzer.
+#
+#  Runs the quick and the full analysis over the position files in this
+#  directory (offline) and writes the figures of every run to [output], one
+#  "<file>.<mode>.<key> <value>" per line. If [baseline] exists, the figures
+#  are compared against it: rates (per second) must not drop, and latencies
+#  must not grow, by more than [tolerance] (a fraction, 0.10 by default).
+#  The p99.9 and maximum latencies are reported but not compared: they come
+#  from a handful of positions and vary by more than the tolerance from one
+#  run to the next. Keys missing from the baseline are not compared, but a
+#  baseline without any figure is an error (it would let every regression
+#  through).
+#
+#  Usage: bench.sh <cha binary> <output> [baseline] [tolerance]
+#
+#  It is meant to be run from src/ through "make bench", after "make cha".
+
+CHA=$1
+OUTPUT=$2
+BASELINE=$3
+TOLERANCE=${4:-0.10}
+DIR=$(dirname "$0")
+TMP=$(mktemp -d)
+
+trap 'rm -rf "$TMP"' EXIT
+
+: > "$OUTPUT"
+
+for file in lichess-30K-games test-vector unfair; do
+  # Test vectors start with the expected results, e.g. "W- ", and comments
+  if [ "$file" = "test-vector" ]; then
+    grep -v '^#' "$DIR/$file.txt" | cut -c4- > "$TMP/input"
+  else
+    cp "$DIR/$file.txt" "$TMP/input"
+  fi
+
+  for mode in quick full; do
+    MODE_FLAG=""
+    [ "$mode" = "quick" ] && MODE_FLAG="-quick"
+
+    "$CHA" $MODE_FLAG -threads 1 -report "$TMP/report" < "$TMP/input" > /dev/null
+    sed "s/^/$file.$mode./" "$TMP/report" >> "$OUTPUT"
+  done
+done
+
+cat "$OUTPUT"
+
+if [ -z "$BASELINE" ] || [ ! -f "$BASELINE" ]; then
+  echo "No baseline to compare against"
+  exit 0
+fi
+
+# Rates are better when higher, latencies (*_us) when lower
+awk -v tol="$TOLERANCE" '
+  /^#/ || NF < 2 { next }
+  NR == FNR { base[$1] = $2; next }
+  !($1 in base) || base[$1] == 0 || $1 ~ /\.(p999|max)_us$/ { next }
+  { compared++ }
+  $1 ~ /_per_sec$/ && $2 < base[$1] * (1 - tol) { bad = 1; print "REGRESSION " $1 ": " $2 " (baseline " base[$1] ")" }
+  $1 ~ /_us$/ && $2 > base[$1] * (1 + tol) { bad = 1; print "REGRESSION " $1 ": " $2 " (baseline " base[$1] ")" }
+  END {
+    if (!compared) { print "No figures in the baseline to compare against, record them with \"make promote-bench\""; exit 1 }
+    if (bad) exit 1
+    print "No regressions in " compared " figures (tolerance " tol ")"
+  }
+' "$BASELINE" "$OUTPUT"